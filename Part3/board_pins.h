@@ -0,0 +1,44 @@
+// Pins of the board: which function is on which pin, with its IOCON
+// configuration (pull mode, hysteresis, input filter, ...).
+//
+// This is the only place where pins are assigned. The register values are
+// calculated from this list by the compiler (see pin_mux.c), and
+// InitPins() only writes them. A pin used twice, a movable function used
+// twice, or a fixed function on a wrong pin stops the build.
+//
+// One line per pin (n is the PIO0_n number):
+//  BOARD_PIN(n, func, iocon)   Movable function kSWM_func on PIO0_n.
+//  BOARD_ALSO(n, func)         One more movable input function that reads
+//                              PIO0_n, which is driven by a BOARD_PIN.
+//  BOARD_ANALOG(n, func)       Fixed analog function (ADC, comparator).
+//                              Pull-up and hysteresis are disabled.
+//  BOARD_FIXED(n, func, iocon) Fixed digital function (I2C0, SWD, ...).
+//  BOARD_GPIO(n, iocon)        General purpose I/O.
+// iocon is made of the IOCON_PIO_* values of pin_mux.h.
+//
+// Fixed functions that are on by default (SWD, RESET) are switched off if
+// their pin is used by a BOARD_PIN or BOARD_GPIO line.
+
+#ifndef _BOARD_PINS_H_
+#define _BOARD_PINS_H_
+
+#define BOARD_PINS							\
+  /* USART0: Alakart P0 (pin 24) and P4 (pin 4). */			\
+  BOARD_PIN(0,  USART0_RXD, IOCON_PIO_MODE_PULLUP)			\
+  BOARD_PIN(4,  USART0_TXD, IOCON_PIO_MODE_PULLUP)			\
+  /* ADC channel 1: Alakart P6 (pin 23). Other channels: "set ch". */	\
+  BOARD_ANALOG(6, ADC_CHN1)						\
+  /* Protection: comparator input, and its output read by SCT input 1. */ \
+  BOARD_ANALOG(1, ACMP_INPUT2)						\
+  BOARD_PIN(15, ACMP_O,     IOCON_PIO_MODE_INACT)			\
+  BOARD_ALSO(15, SCT_PIN1)						\
+  /* External SPI ADC (spi_adc.h). */					\
+  BOARD_PIN(24, SPI0_SCK,   IOCON_PIO_MODE_PULLUP)			\
+  BOARD_PIN(25, SPI0_MISO,  IOCON_PIO_MODE_PULLUP)			\
+  BOARD_PIN(26, SPI0_SSEL0, IOCON_PIO_MODE_PULLUP)			\
+  BOARD_PIN(27, SCT_OUT5,   IOCON_PIO_MODE_PULLUP)   /* CNVST */	\
+  /* I2C0 sensor bus (i2c_async.h), true open-drain pins. */		\
+  BOARD_FIXED(10, I2C0_SCL, IOCON_PIO_I2CMODE_STD)			\
+  BOARD_FIXED(11, I2C0_SDA, IOCON_PIO_I2CMODE_STD)
+
+#endif // _BOARD_PINS_H_
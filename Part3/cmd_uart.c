@@ -0,0 +1,232 @@
+// Command interface on USART0 RX. See cmd_uart.h for the command format.
+
+#include "fsl_device_registers.h"
+#include "fsl_debug_console.h"
+#include "fsl_usart.h"
+#include "cmd_uart.h"
+#include "uart_dma.h"
+
+#define CMD_UART_RX_MASK (CMD_UART_RX_BUF_SIZE - 1U)
+#define CMD_MAX_TOKENS 3U   // "set", name, value
+
+// A token is a part of the line inside the circular buffer.
+// start is a free running index: it must be masked before use.
+typedef struct {
+  uint8_t start;
+  uint8_t len;
+} cmd_token_t;
+
+// Circular receive buffer.
+// rx_head is only written by the ISR, rx_tail only by cmd_uart_poll().
+// Both are free running 8 bit counters: (rx_head - rx_tail) is the number
+// of characters in the buffer. This works because 256 is a multiple of
+// CMD_UART_RX_BUF_SIZE.
+static volatile uint8_t rx_buf[CMD_UART_RX_BUF_SIZE];
+static volatile uint8_t rx_head;
+static uint8_t rx_tail;
+static volatile uint32_t rx_dropped;
+
+static const cmd_param_t *param_table;
+static uint8_t param_count;
+
+
+static inline char rx_at(uint8_t index) {
+  return (char)rx_buf[index & CMD_UART_RX_MASK];
+}
+
+// Compare a token with a normal C string.
+static bool token_equals(const cmd_token_t *tok, const char *str) {
+  uint8_t i;
+
+  for (i = 0; i < tok->len; i++) {
+    if (str[i] != rx_at(tok->start + i)) {
+      return false;
+    }
+  }
+  return (str[i] == '\0');
+}
+
+// Convert a decimal or 0x-prefixed hexadecimal token to a number.
+static bool token_to_u32(const cmd_token_t *tok, uint32_t *value) {
+  uint32_t result = 0;
+  uint32_t base = 10;
+  uint8_t i = 0;
+  uint32_t digit;
+  char c;
+
+  if ((tok->len > 2U) && (rx_at(tok->start) == '0') &&
+      ((rx_at(tok->start + 1U) == 'x') || (rx_at(tok->start + 1U) == 'X'))) {
+    base = 16;
+    i = 2;
+  }
+  if (i == tok->len) {
+    return false;
+  }
+
+  for (; i < tok->len; i++) {
+    c = rx_at(tok->start + i);
+    if ((c >= '0') && (c <= '9')) {
+      digit = (uint32_t)(c - '0');
+    } else if ((base == 16U) && (c >= 'a') && (c <= 'f')) {
+      digit = (uint32_t)(c - 'a' + 10);
+    } else if ((base == 16U) && (c >= 'A') && (c <= 'F')) {
+      digit = (uint32_t)(c - 'A' + 10);
+    } else {
+      return false;
+    }
+    if (result > ((0xFFFFFFFFU - digit) / base)) {
+      return false; // Overflow.
+    }
+    result = result * base + digit;
+  }
+
+  *value = result;
+  return true;
+}
+
+static const cmd_param_t *find_param(const cmd_token_t *tok) {
+  uint8_t i;
+
+  for (i = 0; i < param_count; i++) {
+    if (token_equals(tok, param_table[i].name)) {
+      return &param_table[i];
+    }
+  }
+  return NULL;
+}
+
+static void print_param(const cmd_param_t *param) {
+  CONSOLE_PRINTF("%s=%u\r\n", param->name, (unsigned int)param->get());
+}
+
+// Execute the command made of the tokens found in one line.
+static void execute(const cmd_token_t *tok, uint8_t ntok) {
+  const cmd_param_t *param = NULL;
+  uint32_t value;
+  uint8_t i;
+
+  if (ntok > 1U) {
+    param = find_param(&tok[1]);
+    if (param == NULL) {
+      CONSOLE_PRINTF("ERR unknown parameter\r\n");
+      return;
+    }
+  }
+
+  if (token_equals(&tok[0], "get") && (ntok <= 2U)) {
+    if (param != NULL) {
+      print_param(param);
+    } else {
+      for (i = 0; i < param_count; i++) {
+	print_param(&param_table[i]);
+      }
+    }
+  } else if (token_equals(&tok[0], "set") && (ntok == 3U)) {
+    if (param->set == NULL) {
+      CONSOLE_PRINTF("ERR read only\r\n");
+    } else if (!token_to_u32(&tok[2], &value)) {
+      CONSOLE_PRINTF("ERR bad value\r\n");
+    } else if (!param->set(value)) {
+      CONSOLE_PRINTF("ERR value not accepted\r\n");
+    } else {
+      print_param(param);
+    }
+  } else {
+    CONSOLE_PRINTF("ERR usage: get [name] | set name value\r\n");
+  }
+}
+
+
+void cmd_uart_init(const cmd_param_t *table, uint8_t count) {
+
+  param_table = table;
+  param_count = count;
+  rx_head = 0;
+  rx_tail = 0;
+
+  // USART0 is already initialized by uart_init() (for PRINTF).
+  // Only the receive interrupts are added here:
+  USART_EnableInterrupts(USART0, kUSART_RxReadyInterruptEnable |
+			 kUSART_HardwareOverRunInterruptEnable);
+  NVIC_EnableIRQ(USART0_IRQn);
+}
+
+
+// Called from the main loop.
+// Finds one complete line in the receive buffer, splits it into tokens
+// and executes it. The characters are released only after the command
+// is executed, because the tokens point into the buffer.
+void cmd_uart_poll(void) {
+  cmd_token_t tok[CMD_MAX_TOKENS];
+  uint8_t ntok = 0;
+  uint8_t count = (uint8_t)(rx_head - rx_tail);
+  uint8_t i;
+  char c;
+  bool in_token = false;
+  bool too_many = false;
+
+  for (i = 0; i < count; i++) {
+    c = rx_at(rx_tail + i);
+
+    if ((c == '\r') || (c == '\n')) {
+      if (too_many) {
+	CONSOLE_PRINTF("ERR too many arguments\r\n");
+      } else if (ntok > 0U) {
+	execute(tok, ntok);
+      }
+      rx_tail = (uint8_t)(rx_tail + i + 1U); // Release the line.
+      return;
+    }
+
+    if ((c == ' ') || (c == '\t')) {
+      in_token = false;
+    } else if (in_token) {
+      tok[ntok - 1U].len++;
+    } else if (ntok < CMD_MAX_TOKENS) {
+      tok[ntok].start = (uint8_t)(rx_tail + i);
+      tok[ntok].len = 1;
+      ntok++;
+      in_token = true;
+    } else {
+      too_many = true;
+    }
+  }
+
+  // No line end found. If the buffer is full, the line can never fit:
+  if (count == CMD_UART_RX_BUF_SIZE) {
+    rx_tail = (uint8_t)(rx_tail + count);
+    CONSOLE_PRINTF("ERR line too long\r\n");
+  }
+}
+
+
+uint32_t cmd_uart_dropped(void) {
+  return rx_dropped;
+}
+
+
+// USART0 interrupt: only reception is handled here.
+// (It was declared in the file startup_LPC824.S.)
+void USART0_IRQHandler(void) {
+  uint32_t status = USART0->STAT;
+  uint8_t c;
+
+  if (status & USART_STAT_RXRDY_MASK) {
+    c = (uint8_t)USART0->RXDAT;   // Reading RXDAT clears RXRDY.
+    if ((uint8_t)(rx_head - rx_tail) < CMD_UART_RX_BUF_SIZE) {
+      rx_buf[rx_head & CMD_UART_RX_MASK] = c;
+      rx_head++;
+    } else {
+      rx_dropped++;
+    }
+  }
+
+  // Clear error flags (write 1 to clear). An overrun means a lost character.
+  if (status & USART_STAT_OVERRUNINT_MASK) {
+    rx_dropped++;
+  }
+  USART0->STAT = status & (USART_STAT_OVERRUNINT_MASK |
+			   USART_STAT_FRAMERRINT_MASK |
+			   USART_STAT_PARITYERRINT_MASK |
+			   USART_STAT_RXNOISEINT_MASK);
+}
@@ -0,0 +1,41 @@
+// Command interface on USART0 RX.
+//
+// Received characters are put into a circular buffer by USART0_IRQHandler.
+// cmd_uart_poll() is called from the main loop: it looks for a complete
+// line in the buffer and splits it into tokens *inside* the circular buffer
+// (a token is only a start index and a length), so nothing is copied
+// and no heap is used.
+//
+// Supported commands (one per line, terminated by CR or LF):
+//   get            -> prints all parameters as  name=value
+//   get <name>     -> prints one parameter
+//   set <name> <value>
+//                  -> changes a parameter while the program keeps running.
+// Values may be written in decimal (1000) or hexadecimal (0x3E8).
+
+#ifndef _CMD_UART_H_
+#define _CMD_UART_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Size of the receive buffer. Must be a power of 2 (index is masked).
+#define CMD_UART_RX_BUF_SIZE 64U
+
+// One entry of the parameter table given to cmd_uart_init().
+// get() returns the current value.
+// set() applies a new value and returns false if the value is not accepted.
+// set may be NULL for read only parameters.
+typedef struct {
+  const char *name;
+  uint32_t (*get)(void);
+  bool (*set)(uint32_t value);
+} cmd_param_t;
+
+void cmd_uart_init(const cmd_param_t *table, uint8_t count);
+void cmd_uart_poll(void);
+
+// Number of received characters lost because the buffer was full.
+uint32_t cmd_uart_dropped(void);
+
+#endif // _CMD_UART_H_
@@ -0,0 +1,281 @@
+// Deadline monitor and windowed watchdog. See deadline_mon.h.
+
+#include "fsl_device_registers.h"
+#include "fsl_clock.h"
+#include "fsl_power.h"
+#include "fsl_wwdt.h"
+#include "deadline_mon.h"
+#include "timebase.h"
+#include <string.h>
+
+#define WWDT_WARNING_MAX 1023U   // WARNINT is 10 bits wide.
+#define RESET_RECORD_MAGIC 0x57445452U
+#define RESET_NAME_LEN 12U
+
+typedef struct {
+  deadline_info_t info;
+  uint32_t periodCycles;
+  uint32_t budgetCycles;
+  uint32_t lastBegin;      // timebase_cycles() at the last begin.
+  bool started;            // Has begun at least once.
+  bool late;               // Already counted as late, until next begin.
+} deadline_task_t;
+
+// Kept in the .noinit section: not cleared at reset (see LPC824_flash.ld).
+typedef struct {
+  uint32_t magic;
+  char name[RESET_NAME_LEN];
+} reset_record_t;
+
+static deadline_task_t tasks[DEADLINE_MAX_TASKS];
+static uint8_t numTasks;
+static uint32_t windowTicks;   // Watchdog may be fed when TV < windowTicks.
+static bool watchdogRunning;
+
+static reset_record_t resetRecord __attribute__((section(".noinit")));
+
+
+static uint32_t us_to_cycles(uint32_t us) {
+  return us * timebase_cycles_per_us();
+}
+
+
+uint8_t deadline_register(const char *name, uint32_t periodUs, uint32_t budgetUs) {
+
+  deadline_task_t *task;
+
+  if (numTasks == DEADLINE_MAX_TASKS) {
+    return DEADLINE_INVALID;
+  }
+  task = &tasks[numTasks];
+  memset(task, 0, sizeof(*task));
+  task->info.name = name;
+  deadline_set_timing(numTasks, periodUs, budgetUs);
+
+  return numTasks++;
+}
+
+
+void deadline_set_timing(uint8_t id, uint32_t periodUs, uint32_t budgetUs) {
+
+  uint32_t primask = DisableGlobalIRQ();  // The activity may be an ISR.
+
+  tasks[id].info.periodUs = periodUs;
+  tasks[id].info.budgetUs = budgetUs;
+  tasks[id].periodCycles = us_to_cycles(periodUs);
+  tasks[id].budgetCycles = us_to_cycles(budgetUs);
+  EnableGlobalIRQ(primask);
+}
+
+
+void deadline_begin(uint8_t id) {
+
+  deadline_task_t *task = &tasks[id];
+  uint32_t now = timebase_cycles();
+
+  // Late begin that deadline_supervise() has not seen yet:
+  if (task->started && !task->late && (task->periodCycles != 0U) &&
+      ((now - task->lastBegin) > (2U * task->periodCycles))) {
+    task->info.lateCount++;
+    task->info.lastLateMs = timebase_ms();
+  }
+  task->lastBegin = now;
+  task->started = true;
+  task->late = false;
+}
+
+
+void deadline_end(uint8_t id) {
+
+  deadline_task_t *task = &tasks[id];
+  uint32_t exec = timebase_cycles() - task->lastBegin;
+  uint32_t execUs = exec / timebase_cycles_per_us();
+
+  if (execUs > task->info.maxExecUs) {
+    task->info.maxExecUs = execUs;
+  }
+  if (exec > task->budgetCycles) {
+    task->info.overruns++;
+    task->info.lastOverrunMs = timebase_ms();
+  }
+}
+
+
+// Check all activities; mark and count the ones that are late now.
+// Returns the number of late activities.
+static uint32_t check_tasks(void) {
+
+  uint32_t numLate = 0;
+  uint32_t primask;
+  uint8_t i;
+  deadline_task_t *task;
+
+  for (i = 0; i < numTasks; i++) {
+    task = &tasks[i];
+    // An ISR activity must not begin between reading the time and
+    // comparing it with lastBegin:
+    primask = DisableGlobalIRQ();
+    if (task->started && (task->periodCycles != 0U) &&
+	((timebase_cycles() - task->lastBegin) > (2U * task->periodCycles))) {
+      if (!task->late) {
+	task->late = true;
+	task->info.lateCount++;
+	task->info.lastLateMs = timebase_ms();
+      }
+      numLate++;
+    }
+    EnableGlobalIRQ(primask);
+  }
+  return numLate;
+}
+
+
+void deadline_watchdog_init(uint32_t timeoutMs) {
+
+  wwdt_config_t config;
+  uint32_t wdtFreq;
+  uint32_t timeoutTicks;
+
+  // The watchdog runs from the watchdog oscillator.
+  // CAUTION: Its frequency is only accurate to about +-40%.
+  POWER_DisablePD(kPDRUNCFG_PD_WDT_OSC);
+  CLOCK_InitWdtOsc(kCLOCK_WdtAnaFreq600KHZ, 2U);
+  wdtFreq = CLOCK_GetWdtOscFreq() / 4U;  // The WWDT divides it by 4.
+
+  timeoutTicks = (wdtFreq / 1000U) * timeoutMs;
+  if (timeoutTicks > 0xFFFFFFU) {
+    timeoutTicks = 0xFFFFFFU;   // TC is 24 bits wide.
+  }
+
+  WWDT_GetDefaultConfig(&config);
+  config.clockFreq_Hz = wdtFreq;
+  config.timeoutValue = timeoutTicks;
+  // Feeding is allowed only in the last 3/4 of the timeout. A feed that
+  // comes too early also resets the chip.
+  windowTicks = (timeoutTicks * 3U) / 4U;
+  config.windowValue = windowTicks;
+  // Warning interrupt shortly before the reset:
+  config.warningValue = (timeoutTicks / 4U < WWDT_WARNING_MAX) ?
+			timeoutTicks / 4U : WWDT_WARNING_MAX;
+  config.enableWatchdogReset = true;
+
+  WWDT_Init(WWDT, &config);
+  NVIC_EnableIRQ(WDT_IRQn);
+  watchdogRunning = true;
+}
+
+
+void deadline_supervise(void) {
+
+  if (!watchdogRunning) {
+    (void)check_tasks();
+    return;
+  }
+  // See: 17.6.6 Watchdog Timer Value register. The window opens when
+  // the counter has counted down below WINDOW.
+  if (WWDT->TV >= windowTicks) {
+    return;
+  }
+  if (check_tasks() == 0U) {
+    WWDT_Refresh(WWDT);
+  }
+}
+
+
+uint32_t deadline_late_mask(void) {
+  uint32_t mask = 0;
+  uint8_t i;
+
+  for (i = 0; i < numTasks; i++) {
+    if (tasks[i].late) {
+      mask |= (1U << i);
+    }
+  }
+  return mask;
+}
+
+
+uint32_t deadline_total_overruns(void) {
+  uint32_t total = 0;
+  uint8_t i;
+
+  for (i = 0; i < numTasks; i++) {
+    total += tasks[i].info.overruns;
+  }
+  return total;
+}
+
+
+uint32_t deadline_total_late(void) {
+  uint32_t total = 0;
+  uint8_t i;
+
+  for (i = 0; i < numTasks; i++) {
+    total += tasks[i].info.lateCount;
+  }
+  return total;
+}
+
+
+bool deadline_get_info(uint8_t id, deadline_info_t *info) {
+  if (id >= numTasks) {
+    return false;
+  }
+  *info = tasks[id].info;
+  return true;
+}
+
+
+const char *deadline_last_reset(void) {
+
+  static bool checked;
+  static bool watchdogReset;
+  static char name[RESET_NAME_LEN];
+
+  if (!checked) {
+    // See: 4.6.7 System reset status register. Write 1 to clear.
+    watchdogReset = (SYSCON->SYSRSTSTAT & SYSCON_SYSRSTSTAT_WDT_MASK) != 0U;
+    SYSCON->SYSRSTSTAT = SYSCON_SYSRSTSTAT_WDT_MASK;
+    strcpy(name, "none");
+    if (resetRecord.magic == RESET_RECORD_MAGIC) {
+      memcpy(name, resetRecord.name, RESET_NAME_LEN);
+    }
+    // The record is read once: a later watchdog reset without the
+    // warning interrupt must not show this name again.
+    resetRecord.magic = 0;
+    checked = true;
+  }
+  if (!watchdogReset) {
+    return NULL;
+  }
+  return name;
+}
+
+
+// Watchdog warning interrupt: the watchdog was not fed in time and
+// the chip will be reset soon. Save which activity stalled.
+// It was declared in the file startup_LPC824.S.
+void WDT_IRQHandler(void) {
+
+  uint32_t now = timebase_cycles();
+  uint32_t worst = 0;
+  uint32_t overdue;
+  const char *name = "none";
+  uint8_t i;
+
+  WWDT_ClearStatusFlags(WWDT, kWWDT_WarningFlag);
+
+  for (i = 0; i < numTasks; i++) {
+    overdue = now - tasks[i].lastBegin;
+    if (tasks[i].started && (tasks[i].periodCycles != 0U) &&
+	(overdue > 2U * tasks[i].periodCycles) &&
+	(overdue > worst)) {
+      worst = overdue;
+      name = tasks[i].info.name;
+    }
+  }
+
+  strncpy(resetRecord.name, name, RESET_NAME_LEN - 1U);
+  resetRecord.name[RESET_NAME_LEN - 1U] = '\0';
+  resetRecord.magic = RESET_RECORD_MAGIC;
+}
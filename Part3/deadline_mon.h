@@ -0,0 +1,69 @@
+// Deadline monitor for periodic work, combined with the windowed watchdog.
+//
+// Every periodic activity (an ISR, the main loop, ...) is registered with
+// its period and its time budget. It calls deadline_begin() when its work
+// starts and deadline_end() when it is finished.
+//  - If the work takes longer than the budget, it is an "overrun".
+//  - If the activity does not begin again within two periods, it is "late".
+// Both are counted, and the time (ms since boot) of the last one is kept.
+//
+// deadline_supervise() must be called from the main loop. It feeds the
+// watchdog (WWDT) only if no activity is late. If an activity stalls,
+// the watchdog is not fed: the warning interrupt saves the name of the
+// stalled activity in RAM that is not cleared at reset, and then the
+// watchdog resets the chip. After the reset, deadline_last_reset()
+// tells which activity stalled.
+// See: User Manual Chapter 17, Windowed Watchdog Timer.
+
+#ifndef _DEADLINE_MON_H_
+#define _DEADLINE_MON_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DEADLINE_MAX_TASKS 8U
+#define DEADLINE_INVALID 0xFFU
+
+typedef struct {
+  const char *name;
+  uint32_t periodUs;
+  uint32_t budgetUs;
+  uint32_t overruns;       // Work took longer than the budget.
+  uint32_t lateCount;      // Did not begin again within two periods.
+  uint32_t lastOverrunMs;  // Time of the last overrun.
+  uint32_t lastLateMs;     // Time of the last late begin.
+  uint32_t maxExecUs;      // Longest work seen.
+} deadline_info_t;
+
+// Register an activity. Returns its id, or DEADLINE_INVALID if the table
+// is full.
+uint8_t deadline_register(const char *name, uint32_t periodUs, uint32_t budgetUs);
+
+// Period and budget of an activity may change at run time (e.g. sampling rate).
+// A period of 0 pauses the late check, e.g. while the activity is stopped.
+void deadline_set_timing(uint8_t id, uint32_t periodUs, uint32_t budgetUs);
+
+void deadline_begin(uint8_t id);
+void deadline_end(uint8_t id);
+
+// Start the watchdog. It resets the chip if it is not fed for timeoutMs.
+void deadline_watchdog_init(uint32_t timeoutMs);
+
+// Call often from the main loop. Feeds the watchdog when all activities
+// are on time and the watchdog window is open.
+void deadline_supervise(void);
+
+// Bit n is set if activity n is late now.
+uint32_t deadline_late_mask(void);
+
+// Totals of all activities.
+uint32_t deadline_total_overruns(void);
+uint32_t deadline_total_late(void);
+
+bool deadline_get_info(uint8_t id, deadline_info_t *info);
+
+// If the last reset was made by the watchdog, the name of the activity that
+// stalled (or "none" if none was late). Otherwise NULL.
+const char *deadline_last_reset(void);
+
+#endif // _DEADLINE_MON_H_
@@ -0,0 +1,108 @@
+// Deferred work in PendSV. See defer.h.
+
+#include "fsl_device_registers.h"
+#include "defer.h"
+#include "deadline_mon.h"
+#include "timebase.h"
+
+#define DEFER_MASK (DEFER_QUEUE_LEN - 1U)
+
+typedef struct {
+  defer_fn_t fn;
+  uint32_t arg;
+  uint32_t postedAt;   // timebase_cycles()
+} defer_item_t;
+
+// ISRs of all levels post, so the queue is changed only with the
+// interrupts disabled. head and tail are free running.
+static defer_item_t queue[DEFER_QUEUE_LEN];
+static volatile uint8_t head;
+static volatile uint8_t tail;
+
+static volatile defer_stats_t stats;
+static uint8_t deadlineId = DEADLINE_INVALID;
+
+
+bool defer_post(defer_fn_t fn, uint32_t arg) {
+
+  uint32_t primask = DisableGlobalIRQ();
+  uint8_t depth = (uint8_t)(head - tail);
+  defer_item_t *item;
+
+  if (depth == DEFER_QUEUE_LEN) {
+    stats.dropped++;
+    EnableGlobalIRQ(primask);
+    return false;
+  }
+
+  item = &queue[head & DEFER_MASK];
+  item->fn = fn;
+  item->arg = arg;
+  item->postedAt = timebase_cycles();
+  head++;
+
+  stats.posted++;
+  if ((depth + 1U) > stats.maxDepth) {
+    stats.maxDepth = depth + 1U;
+  }
+  EnableGlobalIRQ(primask);
+
+  // See: ARM Cortex-M0+ Devices Generic User Guide, 4.3.3 Interrupt
+  // Control and State Register.
+  SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+  return true;
+}
+
+
+void defer_get_stats(defer_stats_t *copy) {
+
+  uint32_t primask = DisableGlobalIRQ();
+  *copy = stats;
+  EnableGlobalIRQ(primask);
+}
+
+
+void defer_set_deadline(uint8_t id) {
+  deadlineId = id;
+}
+
+
+// Runs the posted work, with the interrupts enabled.
+// It was declared as a weak function in the file startup_LPC824.S.
+void PendSV_Handler(void) {
+
+  defer_item_t item;
+  uint32_t primask;
+  uint32_t start;
+  uint32_t cycles;
+
+  if (deadlineId != DEADLINE_INVALID) {
+    deadline_begin(deadlineId);
+  }
+  while (1) {
+    primask = DisableGlobalIRQ();
+    if (head == tail) {
+      EnableGlobalIRQ(primask);
+      break;
+    }
+    item = queue[tail & DEFER_MASK];
+    tail++;
+    EnableGlobalIRQ(primask);
+
+    start = timebase_cycles();
+    cycles = start - item.postedAt;
+    if (cycles > stats.maxWaitCycles) {
+      stats.maxWaitCycles = cycles;
+    }
+
+    item.fn(item.arg);
+
+    cycles = timebase_cycles() - start;
+    if (cycles > stats.maxRunCycles) {
+      stats.maxRunCycles = cycles;
+    }
+  }
+  if (deadlineId != DEADLINE_INVALID) {
+    deadline_end(deadlineId);
+  }
+}
@@ -0,0 +1,38 @@
+// Deferred work: the "bottom half" of the ISRs.
+//
+// An ISR only takes its data from the hardware (the "top half") and posts
+// the longer work with defer_post(). The work is done by PendSV_Handler,
+// at the lowest interrupt priority (see irq_prio.h): it is interrupted by
+// every other ISR, but it still runs before the main loop continues.
+//
+// Work items are done in the order they were posted.
+
+#ifndef _DEFER_H_
+#define _DEFER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DEFER_QUEUE_LEN 16U   // Must be a power of 2.
+
+typedef void (*defer_fn_t)(uint32_t arg);
+
+typedef struct {
+  uint32_t posted;
+  uint32_t dropped;          // Queue was full.
+  uint32_t maxDepth;         // Most items waiting at the same time.
+  uint32_t maxWaitCycles;    // Longest time from post to start.
+  uint32_t maxRunCycles;     // Longest work item.
+} defer_stats_t;
+
+// Post fn(arg). May be called from any ISR and from the main loop.
+// Returns false if the queue is full.
+bool defer_post(defer_fn_t fn, uint32_t arg);
+
+void defer_get_stats(defer_stats_t *stats);
+
+// Deadline monitor id (deadline_mon.h) of the work in PendSV. The work is
+// posted at irregular times, so only its budget is checked.
+void defer_set_deadline(uint8_t id);
+
+#endif // _DEFER_H_
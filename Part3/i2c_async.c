@@ -0,0 +1,278 @@
+// Interrupt driven I2C master. See i2c_async.h.
+
+#include "fsl_device_registers.h"
+#include "fsl_clock.h"
+#include "fsl_i2c.h"
+#include "i2c_async.h"
+#include "deadline_mon.h"
+#include "timebase.h"
+
+typedef struct {
+  i2c_xfer_t *xfer;
+  uint32_t periodMs;
+  uint32_t dueMs;
+  uint8_t bus;
+} i2c_job_t;
+
+static I2C_Type *const i2cBase[I2C_NUM_BUSES] = { I2C0, I2C1, I2C2, I2C3 };
+static const IRQn_Type i2cIrq[I2C_NUM_BUSES] = {
+  I2C0_IRQn, I2C1_IRQn, I2C2_IRQn, I2C3_IRQn
+};
+
+static i2c_fsm_t fsm[I2C_NUM_BUSES];
+static bool busReady[I2C_NUM_BUSES];
+static volatile bool tickPending[I2C_NUM_BUSES];
+static bool tickAdded;
+static uint32_t lastBusyTime[I2C_NUM_BUSES];  // For the utilisation.
+static uint32_t lastTime[I2C_NUM_BUSES];
+static uint8_t deadlineId[I2C_NUM_BUSES] = {
+  DEADLINE_INVALID, DEADLINE_INVALID, DEADLINE_INVALID, DEADLINE_INVALID
+};
+
+static i2c_job_t jobs[I2C_MAX_JOBS];
+static volatile uint8_t numJobs;
+static volatile uint32_t jobOverruns;
+
+
+status_t i2c_async_init(uint32_t bus, uint32_t baudRate_Bps) {
+
+  i2c_master_config_t config;
+  I2C_Type *base;
+
+  if (bus >= I2C_NUM_BUSES) {
+    return kStatus_InvalidArgument;
+  }
+  base = i2cBase[bus];
+
+  // Clock, reset and the SCL frequency by the SDK:
+  I2C_MasterGetDefaultConfig(&config);
+  config.baudRate_Bps = baudRate_Bps;
+  I2C_MasterInit(base, &config, CLOCK_GetMainClkFreq());
+
+  // One tick function for all buses:
+  if (!tickAdded) {
+    tickAdded = timebase_add_tick(i2c_async_tick);
+  }
+
+  i2c_fsm_init(&fsm[bus]);
+  lastBusyTime[bus] = 0;
+  lastTime[bus] = timebase_cycles();
+
+  // The master pending interrupt is enabled only while there is work.
+  // See: 19.6.3 Interrupt Enable Set and read register.
+  base->INTENCLR = I2C_INTENCLR_MSTPENDINGCLR_MASK;
+  base->INTENSET = I2C_INTENSET_MSTARBLOSSEN_MASK |
+		   I2C_INTENSET_MSTSTSTPERREN_MASK;
+  NVIC_EnableIRQ(i2cIrq[bus]);
+  busReady[bus] = true;
+  return kStatus_Success;
+}
+
+
+bool i2c_async_submit(uint32_t bus, i2c_xfer_t *xfer) {
+
+  uint32_t primask;
+  bool ok;
+
+  if ((bus >= I2C_NUM_BUSES) || !busReady[bus]) {
+    return false;
+  }
+
+  primask = DisableGlobalIRQ();
+  ok = i2c_fsm_submit(&fsm[bus], xfer);
+  if (ok) {
+    // If the master is idle, the interrupt comes at once and starts it:
+    i2cBase[bus]->INTENSET = I2C_INTENSET_MSTPENDINGEN_MASK;
+  }
+  EnableGlobalIRQ(primask);
+  return ok;
+}
+
+
+uint8_t i2c_job_add(uint32_t bus, i2c_xfer_t *xfer, uint32_t periodMs) {
+
+  uint32_t primask;
+  uint8_t id;
+
+  if ((numJobs >= I2C_MAX_JOBS) || (bus >= I2C_NUM_BUSES) ||
+      (periodMs == 0U)) {
+    return I2C_JOB_INVALID;
+  }
+
+  primask = DisableGlobalIRQ();
+  id = numJobs;
+  jobs[id].xfer = xfer;
+  jobs[id].periodMs = periodMs;
+  jobs[id].dueMs = timebase_ms() + periodMs;
+  jobs[id].bus = (uint8_t)bus;
+  numJobs = id + 1U;
+  EnableGlobalIRQ(primask);
+  return id;
+}
+
+
+void i2c_async_tick(void) {
+
+  uint32_t i;
+
+  // SysTick has a higher priority than the I2C interrupts, and may come
+  // in the middle of i2c_fsm_event(). So the state machine is not used
+  // here; the I2C interrupt does the work (i2c_bus_tick()).
+  for (i = 0; i < I2C_NUM_BUSES; i++) {
+    if (busReady[i]) {
+      tickPending[i] = true;
+      NVIC_SetPendingIRQ(i2cIrq[i]);
+    }
+  }
+}
+
+
+void i2c_async_set_deadline(uint32_t bus, uint8_t id) {
+  if (bus < I2C_NUM_BUSES) {
+    deadlineId[bus] = id;
+  }
+}
+
+
+void i2c_async_get_stats(uint32_t bus, i2c_bus_stats_t *stats) {
+
+  uint32_t primask = DisableGlobalIRQ();
+  *stats = fsm[bus].stats;
+  EnableGlobalIRQ(primask);
+}
+
+
+uint32_t i2c_async_utilisation(uint32_t bus) {
+
+  i2c_bus_stats_t stats;
+  uint32_t now = timebase_cycles();
+  uint32_t busy;
+  uint32_t elapsed;
+
+  i2c_async_get_stats(bus, &stats);
+  busy = stats.busyTime - lastBusyTime[bus];
+  elapsed = now - lastTime[bus];
+  lastBusyTime[bus] = stats.busyTime;
+  lastTime[bus] = now;
+
+  // No 64-bit division; the result is 0 for less than 1000 cycles.
+  elapsed /= 1000U;
+  return (elapsed != 0U) ? (busy / elapsed) : 0U;
+}
+
+
+uint32_t i2c_job_overruns(void) {
+  return jobOverruns;
+}
+
+
+// Millisecond work of a bus, in its I2C interrupt: submit the jobs of the
+// bus that are due, and reset the master after a timeout.
+static void i2c_bus_tick(uint32_t bus) {
+
+  I2C_Type *base = i2cBase[bus];
+  uint32_t now = timebase_ms();
+  uint32_t timeout = I2C_TIMEOUT_MS * 1000U * timebase_cycles_per_us();
+  uint32_t primask;
+  uint32_t i;
+
+  for (i = 0; i < numJobs; i++) {
+    if ((jobs[i].bus == bus) && ((int32_t)(now - jobs[i].dueMs) >= 0)) {
+      jobs[i].dueMs += jobs[i].periodMs;
+      if (!i2c_async_submit(bus, jobs[i].xfer)) {
+	jobOverruns++;   // The last one is not finished yet.
+      }
+    }
+  }
+
+  // The main loop may submit with the interrupts disabled:
+  primask = DisableGlobalIRQ();
+  if (i2c_fsm_check_timeout(&fsm[bus], timebase_cycles(), timeout)) {
+    // Reset the master; it is idle again after this.
+    // (A slave that holds SDA low is not released by this.)
+    base->CFG &= ~I2C_CFG_MSTEN_MASK;
+    base->CFG |= I2C_CFG_MSTEN_MASK;
+    if (fsm[bus].head != NULL) {
+      base->INTENSET = I2C_INTENSET_MSTPENDINGEN_MASK;
+    }
+  }
+  EnableGlobalIRQ(primask);
+}
+
+
+// One step of the master state machine.
+// See: 19.6.2 Status register, MSTSTATE field.
+static void i2c_bus_irq(uint32_t bus) {
+
+  I2C_Type *base = i2cBase[bus];
+  uint32_t stat;
+  uint32_t state;
+  uint32_t errors = 0;
+  uint8_t rxData = 0;
+  i2c_cmd_t cmd;
+
+  if (tickPending[bus]) {   // Pended by i2c_async_tick().
+    tickPending[bus] = false;
+    if (deadlineId[bus] != DEADLINE_INVALID) {
+      deadline_begin(deadlineId[bus]);
+    }
+    i2c_bus_tick(bus);
+    if (deadlineId[bus] != DEADLINE_INVALID) {
+      deadline_end(deadlineId[bus]);
+    }
+  }
+
+  stat = base->STAT;
+  state = (stat & I2C_STAT_MSTSTATE_MASK) >> I2C_STAT_MSTSTATE_SHIFT;
+
+  if ((stat & I2C_STAT_MSTARBLOSS_MASK) != 0U) {
+    errors |= I2C_EVENT_ARB_LOSS;
+  }
+  if ((stat & I2C_STAT_MSTSTSTPERR_MASK) != 0U) {
+    errors |= I2C_EVENT_BUS_ERROR;
+  }
+  if (errors != 0U) {
+    // Write 1 to clear:
+    base->STAT = stat & (I2C_STAT_MSTARBLOSS_MASK | I2C_STAT_MSTSTSTPERR_MASK);
+  } else if ((stat & I2C_STAT_MSTPENDING_MASK) == 0U) {
+    return;
+  }
+
+  if (state == I2C_MST_RX_READY) {
+    rxData = (uint8_t)base->MSTDAT;
+  }
+
+  cmd = i2c_fsm_event(&fsm[bus], state, rxData, errors, timebase_cycles());
+
+  if ((cmd.flags & I2C_CMD_IDLE) != 0U) {
+    base->INTENCLR = I2C_INTENCLR_MSTPENDINGCLR_MASK;
+    return;
+  }
+  if ((cmd.flags & I2C_CMD_WRITE) != 0U) {
+    base->MSTDAT = cmd.data;
+  }
+  // I2C_CMD_CONTINUE, _START and _STOP are the bits of MSTCTL.
+  // See: 19.6.8 Master Control register.
+  if ((cmd.flags & 0x7U) != 0U) {
+    base->MSTCTL = cmd.flags & 0x7U;
+  }
+}
+
+
+// ISRs of the I2C buses.
+// They were declared in the file startup_LPC824.S.
+void I2C0_IRQHandler(void) {
+  i2c_bus_irq(0);
+}
+
+void I2C1_IRQHandler(void) {
+  i2c_bus_irq(1);
+}
+
+void I2C2_IRQHandler(void) {
+  i2c_bus_irq(2);
+}
+
+void I2C3_IRQHandler(void) {
+  i2c_bus_irq(3);
+}
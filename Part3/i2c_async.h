@@ -0,0 +1,65 @@
+// Interrupt driven I2C master with a transaction queue per bus, and
+// periodic polling jobs for sensors.
+//
+// i2c_async_submit() only puts the transaction into the queue of the bus
+// and returns; nothing waits for the bus. The I2C interrupt runs the state
+// machine of i2c_fsm.h and calls the 'done' callback of the transaction.
+// The callbacks run in the I2C interrupt, so they must be short; longer
+// work can be posted with defer_post().
+//
+// A job submits the same transaction every periodMs. The SysTick interrupt
+// only pends the I2C interrupt every millisecond (i2c_async_tick()); the
+// jobs are started and the timeouts checked in the I2C interrupt. So the
+// state machine of a bus is only used at the I2C priority level (or with
+// the interrupts disabled), and the SCT timed ADC sampling is not delayed
+// by the I2C at all.
+//
+// The pins of the buses are in board_pins.h (I2C0: PIO0_10 SCL, PIO0_11 SDA).
+
+#ifndef _I2C_ASYNC_H_
+#define _I2C_ASYNC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fsl_common.h"
+#include "i2c_fsm.h"
+
+#define I2C_NUM_BUSES 4U       // I2C0 .. I2C3
+#define I2C_MAX_JOBS 8U
+#define I2C_JOB_INVALID 0xFFU
+#define I2C_TIMEOUT_MS 10U     // Longest transaction before the bus is reset.
+
+// Set up bus 0 .. 3 as master with the given SCL frequency.
+status_t i2c_async_init(uint32_t bus, uint32_t baudRate_Bps);
+
+// Add a transaction to the queue of the bus. May be called from the main
+// loop, from an ISR of the I2C priority level or lower (irq_prio.h), and
+// from a 'done' callback; not from a higher level ISR, which could
+// interrupt the state machine. Returns false if the bus
+// is not initialized, or the transaction is already pending or empty.
+bool i2c_async_submit(uint32_t bus, i2c_xfer_t *xfer);
+
+// Submit 'xfer' every periodMs, from periodMs after now. Returns the job id,
+// or I2C_JOB_INVALID if the table is full.
+uint8_t i2c_job_add(uint32_t bus, i2c_xfer_t *xfer, uint32_t periodMs);
+
+// Called from the SysTick interrupt every millisecond (added to the time
+// base by i2c_async_init()): pends the I2C interrupts,
+// which start the jobs that are due, and stop transactions that take
+// longer than I2C_TIMEOUT_MS.
+void i2c_async_tick(void);
+
+// Deadline monitor id (deadline_mon.h) of the millisecond work of a bus
+// in its I2C interrupt (period 1 ms).
+void i2c_async_set_deadline(uint32_t bus, uint8_t id);
+
+void i2c_async_get_stats(uint32_t bus, i2c_bus_stats_t *stats);
+
+// Part of the time the bus was busy with transactions (per mille), since
+// the last call.
+uint32_t i2c_async_utilisation(uint32_t bus);
+
+// Jobs that were due while their last transaction was still pending.
+uint32_t i2c_job_overruns(void);
+
+#endif // _I2C_ASYNC_H_
@@ -0,0 +1,161 @@
+// Transaction queue and state machine of one I2C bus. See i2c_fsm.h.
+
+#include <stddef.h>
+#include "i2c_fsm.h"
+
+
+void i2c_fsm_init(i2c_fsm_t *fsm) {
+
+  fsm->head = NULL;
+  fsm->tail = NULL;
+  fsm->active = false;
+  fsm->txCount = 0;
+  fsm->rxCount = 0;
+  fsm->startTime = 0;
+  fsm->stats = (i2c_bus_stats_t){ 0 };
+}
+
+
+bool i2c_fsm_submit(i2c_fsm_t *fsm, i2c_xfer_t *xfer) {
+
+  if ((xfer->status == kI2cXfer_Pending) ||
+      ((xfer->txLen == 0U) && (xfer->rxLen == 0U)) ||
+      ((xfer->txLen != 0U) && (xfer->tx == NULL)) ||
+      ((xfer->rxLen != 0U) && (xfer->rx == NULL))) {
+    return false;
+  }
+
+  xfer->status = kI2cXfer_Pending;
+  xfer->next = NULL;
+  if (fsm->head == NULL) {
+    fsm->head = xfer;
+  } else {
+    fsm->tail->next = xfer;
+  }
+  fsm->tail = xfer;
+  return true;
+}
+
+
+// Remove the transaction on the bus from the queue and call its callback.
+static void finish(i2c_fsm_t *fsm, i2c_xfer_status_t status, uint32_t now) {
+
+  i2c_xfer_t *xfer = fsm->head;
+
+  fsm->head = xfer->next;
+  if (fsm->head == NULL) {
+    fsm->tail = NULL;
+  }
+  fsm->active = false;
+  fsm->stats.busyTime += now - fsm->startTime;
+
+  switch (status) {
+  case kI2cXfer_Done:     fsm->stats.done++;      break;
+  case kI2cXfer_NackAddr: fsm->stats.nackAddr++;  break;
+  case kI2cXfer_NackData: fsm->stats.nackData++;  break;
+  case kI2cXfer_ArbLost:  fsm->stats.arbLost++;   break;
+  case kI2cXfer_Timeout:  fsm->stats.timeouts++;  break;
+  default:                fsm->stats.busErrors++; break;
+  }
+
+  xfer->status = status;
+  if (xfer->done != NULL) {
+    xfer->done(xfer);   // May submit it again.
+  }
+}
+
+
+// START with the address. The read address if there is nothing (left)
+// to write.
+static i2c_cmd_t start(const i2c_xfer_t *xfer, bool read) {
+
+  i2c_cmd_t cmd;
+
+  cmd.flags = I2C_CMD_WRITE | I2C_CMD_START;
+  cmd.data = (uint8_t)((xfer->addr << 1) | (read ? 1U : 0U));
+  return cmd;
+}
+
+
+i2c_cmd_t i2c_fsm_event(i2c_fsm_t *fsm, uint32_t state, uint8_t rxData,
+			uint32_t errors, uint32_t now) {
+
+  i2c_cmd_t cmd = { 0, 0 };
+  i2c_xfer_t *xfer;
+
+  // After an arbitration loss or a bus error the master is idle again.
+  if (fsm->active && (errors != 0U)) {
+    finish(fsm, ((errors & I2C_EVENT_ARB_LOSS) != 0U) ?
+		kI2cXfer_ArbLost : kI2cXfer_BusError, now);
+    return cmd;   // The next one starts with the next idle event.
+  }
+
+  xfer = fsm->head;
+
+  if (!fsm->active) {
+    if (state != I2C_MST_IDLE) {
+      // Left over from a timeout; should not happen.
+      cmd.flags = I2C_CMD_STOP;
+    } else if (xfer == NULL) {
+      cmd.flags = I2C_CMD_IDLE;
+    } else {
+      fsm->active = true;
+      fsm->txCount = 0;
+      fsm->rxCount = 0;
+      fsm->startTime = now;
+      cmd = start(xfer, xfer->txLen == 0U);
+    }
+    return cmd;
+  }
+
+  switch (state) {
+  case I2C_MST_TX_READY:
+    if (fsm->txCount < xfer->txLen) {
+      cmd.flags = I2C_CMD_WRITE | I2C_CMD_CONTINUE;
+      cmd.data = xfer->tx[fsm->txCount++];
+    } else if (xfer->rxLen != 0U) {
+      cmd = start(xfer, true);   // Repeated START for the read part.
+    } else {
+      cmd.flags = I2C_CMD_STOP;
+      finish(fsm, kI2cXfer_Done, now);
+    }
+    break;
+
+  case I2C_MST_RX_READY:
+    if (fsm->rxCount < xfer->rxLen) {
+      xfer->rx[fsm->rxCount++] = rxData;
+    }
+    if (fsm->rxCount < xfer->rxLen) {
+      cmd.flags = I2C_CMD_CONTINUE;   // ACK, and receive the next byte.
+    } else {
+      cmd.flags = I2C_CMD_STOP;       // NACK the last byte, and STOP.
+      finish(fsm, kI2cXfer_Done, now);
+    }
+    break;
+
+  case I2C_MST_NACK_ADDR:
+    cmd.flags = I2C_CMD_STOP;
+    finish(fsm, kI2cXfer_NackAddr, now);
+    break;
+
+  case I2C_MST_NACK_DATA:
+    cmd.flags = I2C_CMD_STOP;
+    finish(fsm, kI2cXfer_NackData, now);
+    break;
+
+  default:   // Idle during a transaction.
+    finish(fsm, kI2cXfer_BusError, now);
+    break;
+  }
+  return cmd;
+}
+
+
+bool i2c_fsm_check_timeout(i2c_fsm_t *fsm, uint32_t now, uint32_t timeout) {
+
+  if (!fsm->active || ((now - fsm->startTime) <= timeout)) {
+    return false;
+  }
+  finish(fsm, kI2cXfer_Timeout, now);
+  return true;
+}
@@ -0,0 +1,116 @@
+// Transaction queue and state machine of one I2C bus (used by i2c_async.h).
+//
+// This part does not access the hardware, so it can also be compiled on a
+// PC and tested with a model of the I2C master and the slaves.
+//
+// The LPC824 I2C master stops after every step (address sent, byte sent,
+// byte received, ...), sets MSTPENDING and tells in MSTSTATE what happened.
+// Then the interrupt calls i2c_fsm_event() with MSTSTATE, and writes the
+// returned command to MSTDAT and MSTCTL. The next transaction of the queue
+// is started when the master is idle again.
+// See: User Manual Chapter 19, I2C-bus interface (master function).
+//
+// A transaction is one of:
+//  - write:    START addr+W tx[0..txLen-1] STOP           (rxLen = 0)
+//  - read:     START addr+R rx[0..rxLen-1] STOP           (txLen = 0)
+//  - combined: START addr+W tx[...] START addr+R rx[...] STOP
+//    (e.g. write the register number, then read the register)
+
+#ifndef _I2C_FSM_H_
+#define _I2C_FSM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// MSTSTATE values (STAT register, bits 3:1).
+#define I2C_MST_IDLE      0U
+#define I2C_MST_RX_READY  1U
+#define I2C_MST_TX_READY  2U
+#define I2C_MST_NACK_ADDR 3U
+#define I2C_MST_NACK_DATA 4U
+
+// Errors given with the event (STAT register flags).
+#define I2C_EVENT_ARB_LOSS  0x1U   // MSTARBLOSS: another master won.
+#define I2C_EVENT_BUS_ERROR 0x2U   // MSTSTSTPERR: START/STOP at wrong time.
+
+// Command bits returned by i2c_fsm_event(). The first 3 are the bits of
+// the MSTCTL register.
+#define I2C_CMD_CONTINUE 0x001U
+#define I2C_CMD_START    0x002U
+#define I2C_CMD_STOP     0x004U
+#define I2C_CMD_WRITE    0x100U  // Write 'data' to MSTDAT before MSTCTL.
+#define I2C_CMD_IDLE     0x200U  // Queue empty: disable the interrupt.
+
+typedef enum {
+  kI2cXfer_Done = 0,
+  kI2cXfer_Pending,      // In the queue or on the bus.
+  kI2cXfer_NackAddr,     // No slave answered.
+  kI2cXfer_NackData,     // The slave did not accept a byte.
+  kI2cXfer_ArbLost,
+  kI2cXfer_BusError,
+  kI2cXfer_Timeout,
+} i2c_xfer_status_t;
+
+typedef struct i2c_xfer i2c_xfer_t;
+
+// Called (in the interrupt) when the transaction is finished.
+typedef void (*i2c_xfer_cb_t)(i2c_xfer_t *xfer);
+
+// The memory of a transaction belongs to the caller; it must not be
+// changed while its status is kI2cXfer_Pending.
+struct i2c_xfer {
+  uint8_t addr;              // 7-bit slave address.
+  uint8_t txLen;
+  uint8_t rxLen;
+  const uint8_t *tx;
+  uint8_t *rx;
+  i2c_xfer_cb_t done;        // May be NULL.
+  void *userData;
+  volatile i2c_xfer_status_t status;
+  i2c_xfer_t *next;          // Used by the queue.
+};
+
+typedef struct {
+  uint32_t done;
+  uint32_t nackAddr;
+  uint32_t nackData;
+  uint32_t arbLost;
+  uint32_t busErrors;
+  uint32_t timeouts;
+  uint32_t busyTime;         // Sum of the transaction times (see 'now').
+} i2c_bus_stats_t;
+
+typedef struct {
+  uint32_t flags;            // I2C_CMD_*
+  uint8_t data;              // For I2C_CMD_WRITE.
+} i2c_cmd_t;
+
+typedef struct {
+  i2c_xfer_t *head;          // Oldest; on the bus if 'active'.
+  i2c_xfer_t *tail;
+  bool active;
+  uint8_t txCount;
+  uint8_t rxCount;
+  uint32_t startTime;
+  i2c_bus_stats_t stats;
+} i2c_fsm_t;
+
+void i2c_fsm_init(i2c_fsm_t *fsm);
+
+// Add a transaction to the queue. Returns false if it is already pending
+// or empty. Must not be interrupted by i2c_fsm_event().
+bool i2c_fsm_submit(i2c_fsm_t *fsm, i2c_xfer_t *xfer);
+
+// One step of the master. 'state' is MSTSTATE, 'rxData' is MSTDAT (used
+// only in I2C_MST_RX_READY), 'errors' are I2C_EVENT_* flags. 'now' is any
+// time (e.g. cycles); the busy time of the bus is counted in its units.
+i2c_cmd_t i2c_fsm_event(i2c_fsm_t *fsm, uint32_t state, uint8_t rxData,
+			uint32_t errors, uint32_t now);
+
+// Stop the transaction on the bus if it has been running for longer than
+// 'timeout'. Returns true if it was stopped; then the master must be
+// reset (the bus may be held by a slave). Must not be interrupted by
+// i2c_fsm_event().
+bool i2c_fsm_check_timeout(i2c_fsm_t *fsm, uint32_t now, uint32_t timeout);
+
+#endif // _I2C_FSM_H_
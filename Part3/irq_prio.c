@@ -0,0 +1,99 @@
+// Interrupt priority plan and latency probe. See irq_prio.h.
+
+#include "fsl_device_registers.h"
+#include "irq_prio.h"
+#include "timebase.h"
+
+#define PROBE_IRQn PIN_INT7_IRQn
+
+typedef struct {
+  IRQn_Type irq;
+  uint8_t priority;
+} irq_prio_entry_t;
+
+// The priority of every interrupt used by the program, in one place.
+static const irq_prio_entry_t irqPrioTable[] = {
+  { SysTick_IRQn,   IRQ_PRIO_CAPTURE },  // Time base, and the latency probe.
+  { ADC0_SEQA_IRQn, IRQ_PRIO_CAPTURE },  // Results overwritten by next trigger.
+  { PIN_INT0_IRQn,  IRQ_PRIO_CAPTURE },  // Time stamps of pin events.
+  { PIN_INT1_IRQn,  IRQ_PRIO_CAPTURE },
+  { PIN_INT2_IRQn,  IRQ_PRIO_CAPTURE },
+  { PIN_INT3_IRQn,  IRQ_PRIO_CAPTURE },
+  { WDT_IRQn,       IRQ_PRIO_CAPTURE },  // Last chance before the reset.
+  { USART0_IRQn,    IRQ_PRIO_STREAM },   // Only 1 received character buffered.
+  { DMA0_IRQn,      IRQ_PRIO_STREAM },   // UART frames, SPI ADC blocks.
+  { MRT0_IRQn,      IRQ_PRIO_STREAM },
+  { I2C0_IRQn,      IRQ_PRIO_STREAM },   // Sensor buses (i2c_async.h).
+  { I2C1_IRQn,      IRQ_PRIO_STREAM },
+  { I2C2_IRQn,      IRQ_PRIO_STREAM },
+  { I2C3_IRQn,      IRQ_PRIO_STREAM },
+  { SCT0_IRQn,      IRQ_PRIO_STREAM },
+  { CMP_IRQn,       IRQ_PRIO_LOG },      // The SCT already stopped the PWM.
+  { PendSV_IRQn,    IRQ_PRIO_DEFERRED }, // Deferred work (defer.h).
+};
+
+#define IRQ_PRIO_TABLE_LEN (sizeof(irqPrioTable) / sizeof(irqPrioTable[0]))
+
+static volatile irq_latency_t latency[IRQ_PRIO_LEVELS];
+static volatile uint32_t probeStart;
+static volatile uint8_t probeLevel;
+static volatile bool probeBusy;
+
+
+void irq_prio_init(void) {
+
+  uint32_t i;
+
+  for (i = 0; i < IRQ_PRIO_TABLE_LEN; i++) {
+    NVIC_SetPriority(irqPrioTable[i].irq, irqPrioTable[i].priority);
+  }
+
+  probeLevel = IRQ_PRIO_LEVELS - 1U;
+  probeBusy = false;
+  NVIC_ClearPendingIRQ(PROBE_IRQn);
+  NVIC_EnableIRQ(PROBE_IRQn);
+  (void)timebase_add_tick(irq_prio_probe_tick);
+}
+
+
+void irq_prio_probe_tick(void) {
+
+  static uint32_t ms;
+
+  if ((++ms < IRQ_PROBE_INTERVAL_MS) || probeBusy) {
+    return;
+  }
+  ms = 0;
+
+  // The priority is changed only while the probe is neither pending nor
+  // active:
+  probeLevel = (uint8_t)((probeLevel + 1U) % IRQ_PRIO_LEVELS);
+  NVIC_SetPriority(PROBE_IRQn, probeLevel);
+  probeBusy = true;
+  probeStart = timebase_cycles();
+  NVIC_SetPendingIRQ(PROBE_IRQn);
+}
+
+
+void irq_prio_get_latency(uint32_t level, irq_latency_t *copy) {
+
+  uint32_t primask = DisableGlobalIRQ();
+  *copy = latency[level];
+  EnableGlobalIRQ(primask);
+}
+
+
+// Latency probe. It starts when no ISR of the same or a higher level runs.
+// It was declared in the file startup_LPC824.S.
+void PIN_INT7_IRQHandler(void) {
+
+  uint32_t cycles = timebase_cycles() - probeStart;
+  volatile irq_latency_t *level = &latency[probeLevel];
+
+  level->count++;
+  level->lastCycles = cycles;
+  if (cycles > level->maxCycles) {
+    level->maxCycles = cycles;
+  }
+  probeBusy = false;
+}
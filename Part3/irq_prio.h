@@ -0,0 +1,48 @@
+// Interrupt priority plan of the program, and measurement of the
+// interrupt latency at each priority level.
+//
+// The Cortex-M0+ has 4 priority levels; 0 is the highest. An ISR is
+// interrupted only by ISRs of a higher (smaller) level.
+//  0 CAPTURE:  Take data that is overwritten soon (ADC results, pin event
+//              time stamps) and keep the time. Must be very short.
+//  1 STREAM:   Data streams with a little buffering (DMA, USART, MRT,
+//              I2C).
+//  2 LOG:      Events that are only counted (comparator trip).
+//  3 DEFERRED: PendSV: the longer work posted by the ISRs (see defer.h).
+// All priorities are in the table of irq_prio.c and set by irq_prio_init().
+//
+// Latency probe: every IRQ_PROBE_INTERVAL_MS the SysTick ISR pends the
+// PIN_INT7 interrupt (not used otherwise in this program) at the next
+// level in turn. The time until its ISR starts is the time an interrupt of
+// that level had to wait for the ISRs of higher or equal level.
+
+#ifndef _IRQ_PRIO_H_
+#define _IRQ_PRIO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IRQ_PRIO_CAPTURE  0U
+#define IRQ_PRIO_STREAM   1U
+#define IRQ_PRIO_LOG      2U
+#define IRQ_PRIO_DEFERRED 3U
+#define IRQ_PRIO_LEVELS   4U
+
+#define IRQ_PROBE_INTERVAL_MS 10U
+
+typedef struct {
+  uint32_t count;      // Measurements.
+  uint32_t lastCycles;
+  uint32_t maxCycles;
+} irq_latency_t;
+
+// Set the priorities of all interrupts, and start the latency probe.
+// Call after timebase_init(), before the other interrupts are enabled.
+void irq_prio_init(void);
+
+// Called from the SysTick interrupt every millisecond (timebase_add_tick()).
+void irq_prio_probe_tick(void);
+
+void irq_prio_get_latency(uint32_t level, irq_latency_t *latency);
+
+#endif // _IRQ_PRIO_H_
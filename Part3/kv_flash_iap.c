@@ -0,0 +1,66 @@
+// Flash interface of the key/value store for the LPC824 (see kv_store.h).
+//
+// The flash is written by the IAP functions in the boot ROM.
+// See: Chapter 26 LPC82x Flash ISP and IAP programming, in the User Manual.
+//  - A sector must be "prepared" before every erase or write.
+//  - While the IAP works, the flash can not be read. The vector table and
+//    the ISRs are in flash, so interrupts are disabled during the call.
+//    A sector erase takes about 100 ms: ADC samples are lost meanwhile.
+//  - The IAP uses the top 32 bytes of RAM (not used in LPC824_flash.ld).
+
+#include "fsl_device_registers.h"
+#include "fsl_iap.h"
+#include "kv_store.h"
+
+#define FLASH_SECTOR_SIZE 1024U
+#define STORE_SECTORS 2U   // Must match LENGTH(m_kvstore) in LPC824_flash.ld.
+
+// Start of the m_kvstore region. Defined in LPC824_flash.ld.
+extern const uint8_t __KV_STORE_START[];
+
+#define STORE_START ((uint32_t)__KV_STORE_START)
+
+
+static status_t iap_erase(uint32_t sector) {
+
+  uint32_t flashSector = (STORE_START / FLASH_SECTOR_SIZE) + sector;
+  uint32_t primask;
+  status_t status;
+
+  primask = DisableGlobalIRQ();
+  status = IAP_PrepareSectorForWrite(flashSector, flashSector);
+  if (status == kStatus_IAP_Success) {
+    status = IAP_EraseSector(flashSector, flashSector, SystemCoreClock);
+  }
+  EnableGlobalIRQ(primask);
+
+  return (status == kStatus_IAP_Success) ? kStatus_Success : kStatus_Fail;
+}
+
+
+static status_t iap_program(uint32_t offset, const uint32_t *data) {
+
+  uint32_t address = STORE_START + offset;
+  uint32_t flashSector = address / FLASH_SECTOR_SIZE;
+  uint32_t primask;
+  status_t status;
+
+  primask = DisableGlobalIRQ();
+  status = IAP_PrepareSectorForWrite(flashSector, flashSector);
+  if (status == kStatus_IAP_Success) {
+    status = IAP_CopyRamToFlash(address, (uint32_t *)data, KV_PAGE_SIZE,
+				SystemCoreClock);
+  }
+  EnableGlobalIRQ(primask);
+
+  return (status == kStatus_IAP_Success) ? kStatus_Success : kStatus_Fail;
+}
+
+
+const kv_flash_t kvFlashIap = {
+  .mem = __KV_STORE_START,
+  .sectorSize = FLASH_SECTOR_SIZE,
+  .numSectors = STORE_SECTORS,
+  .erase = iap_erase,
+  .program = iap_program,
+};
@@ -0,0 +1,317 @@
+// Key/value store in flash. See kv_store.h.
+//
+// Only this file knows the record format. The flash itself is accessed
+// through the kv_flash_t functions.
+
+#include "kv_store.h"
+#include <stddef.h>
+#include <string.h>
+
+#define HEADER_MAGIC 0x5453564BU  // "KVST"
+#define RECORD_MAGIC 0x564BU      // "KV"
+#define NO_RECORD 0xFFFFFFFFU
+
+// Page 0 of every sector.
+typedef struct {
+  uint32_t magic;
+  uint32_t generation;  // +1 for every new active sector.
+  uint32_t crc;         // Of magic and generation.
+  uint32_t unused[(KV_PAGE_SIZE / 4U) - 3U];  // Left erased (0xFF).
+} kv_header_t;
+
+// All other pages. One record is one value of one key.
+typedef struct {
+  uint16_t magic;
+  uint8_t key;
+  uint8_t len;          // 0: the key was deleted.
+  uint8_t data[KV_MAX_VALUE_LEN];
+  uint32_t crc;         // Of all bytes before it.
+} kv_record_t;
+
+_Static_assert(sizeof(kv_header_t) == KV_PAGE_SIZE, "header must be one page");
+_Static_assert(sizeof(kv_record_t) == KV_PAGE_SIZE, "record must be one page");
+
+static const kv_flash_t *flash;
+static uint32_t activeSector;
+static uint32_t generation;
+static uint32_t writeOffset;   // Next free page, from the start of the sector.
+static uint32_t recordOffset[KV_MAX_KEYS]; // Newest record of each key.
+static uint32_t eraseCount;
+
+// The IAP copies from word aligned RAM, so every page is built here:
+static union {
+  kv_header_t header;
+  kv_record_t record;
+} pageBuf;
+
+
+// CRC-32 (polynomial 0xEDB88320, as in Ethernet and zip).
+// Bit by bit: slower than a table, but it needs no flash for the table.
+static uint32_t crc32(const void *data, uint32_t len) {
+
+  const uint8_t *p = data;
+  uint32_t crc = 0xFFFFFFFFU;
+  uint32_t bit;
+
+  while (len--) {
+    crc ^= *p++;
+    for (bit = 0; bit < 8U; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+  }
+  return ~crc;
+}
+
+
+static const void *page_at(uint32_t offset) {
+  return flash->mem + offset;
+}
+
+
+static bool page_erased(uint32_t offset) {
+
+  const uint32_t *word = page_at(offset);
+  uint32_t i;
+
+  for (i = 0; i < KV_PAGE_SIZE / 4U; i++) {
+    if (word[i] != 0xFFFFFFFFU) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+static bool header_valid(const kv_header_t *header) {
+  return (header->magic == HEADER_MAGIC) &&
+	 (header->crc == crc32(header, 2U * sizeof(uint32_t)));
+}
+
+
+static bool record_valid(const kv_record_t *record) {
+  return (record->magic == RECORD_MAGIC) &&
+	 (record->key < KV_MAX_KEYS) &&
+	 (record->len <= KV_MAX_VALUE_LEN) &&
+	 (record->crc == crc32(record, offsetof(kv_record_t, crc)));
+}
+
+
+// Write pageBuf and read it back.
+static status_t write_page(uint32_t offset) {
+
+  status_t status = flash->program(offset, (const uint32_t *)&pageBuf);
+
+  if (status != kStatus_Success) {
+    return status;
+  }
+  return (memcmp(page_at(offset), &pageBuf, KV_PAGE_SIZE) == 0) ?
+	 kStatus_Success : kStatus_Fail;
+}
+
+
+// Find the newest record of every key in the active sector, and the
+// first free page. Pages that are not erased but not valid (a write was
+// interrupted) are skipped.
+static void scan_sector(void) {
+
+  uint32_t base = activeSector * flash->sectorSize;
+  uint32_t offset;
+  const kv_record_t *record;
+
+  memset(recordOffset, 0xFF, sizeof(recordOffset));  // NO_RECORD
+  writeOffset = KV_PAGE_SIZE;
+
+  for (offset = KV_PAGE_SIZE; offset < flash->sectorSize; offset += KV_PAGE_SIZE) {
+    if (page_erased(base + offset)) {
+      continue;
+    }
+    writeOffset = offset + KV_PAGE_SIZE;
+    record = page_at(base + offset);
+    if (record_valid(record)) {
+      recordOffset[record->key] = (record->len != 0U) ? (base + offset) : NO_RECORD;
+    }
+  }
+}
+
+
+// Make the next sector active, with a copy of the newest record of every key.
+static status_t compact(void) {
+
+  uint32_t next = (activeSector + 1U) % flash->numSectors;
+  uint32_t base = next * flash->sectorSize;
+  uint32_t offset = KV_PAGE_SIZE;
+  uint32_t newOffset[KV_MAX_KEYS];
+  uint32_t key;
+  status_t status;
+
+  // The next sector holds only old records: all of its newest ones were
+  // copied into the active sector when that became active.
+  status = flash->erase(next);
+  eraseCount++;
+  if (status != kStatus_Success) {
+    return status;
+  }
+
+  for (key = 0; key < KV_MAX_KEYS; key++) {
+    newOffset[key] = NO_RECORD;
+    if (recordOffset[key] == NO_RECORD) {
+      continue;
+    }
+    memcpy(&pageBuf, page_at(recordOffset[key]), KV_PAGE_SIZE);
+    status = write_page(base + offset);
+    if (status != kStatus_Success) {
+      return status;
+    }
+    newOffset[key] = base + offset;
+    offset += KV_PAGE_SIZE;
+  }
+
+  // Header last. Until here the old sector is still the active one.
+  memset(&pageBuf, 0xFF, KV_PAGE_SIZE);
+  pageBuf.header.magic = HEADER_MAGIC;
+  pageBuf.header.generation = generation + 1U;
+  pageBuf.header.crc = crc32(&pageBuf.header, 2U * sizeof(uint32_t));
+  status = write_page(base);
+  if (status != kStatus_Success) {
+    return status;
+  }
+
+  activeSector = next;
+  generation++;
+  writeOffset = offset;
+  memcpy(recordOffset, newOffset, sizeof(recordOffset));
+  return kStatus_Success;
+}
+
+
+// Write a new record after the last one.
+static status_t append(uint8_t key, const void *value, uint32_t len) {
+
+  uint32_t offset;
+  status_t status;
+
+  if (writeOffset >= flash->sectorSize) {
+    status = compact();
+    if (status != kStatus_Success) {
+      return status;
+    }
+  }
+
+  memset(&pageBuf, 0xFF, KV_PAGE_SIZE);
+  pageBuf.record.magic = RECORD_MAGIC;
+  pageBuf.record.key = key;
+  pageBuf.record.len = (uint8_t)len;
+  if (len != 0U) {
+    memcpy(pageBuf.record.data, value, len);
+  }
+  pageBuf.record.crc = crc32(&pageBuf.record, offsetof(kv_record_t, crc));
+
+  offset = (activeSector * flash->sectorSize) + writeOffset;
+  writeOffset += KV_PAGE_SIZE;  // Used, even if the write fails.
+  status = write_page(offset);
+  if (status == kStatus_Success) {
+    recordOffset[key] = (len != 0U) ? offset : NO_RECORD;
+  }
+  return status;
+}
+
+
+status_t kv_init(const kv_flash_t *flashIf) {
+
+  const kv_header_t *header;
+  bool found = false;
+  uint32_t sector;
+  status_t status;
+
+  // After compaction a sector must still have free pages:
+  if ((flashIf->numSectors < 2U) ||
+      ((flashIf->sectorSize / KV_PAGE_SIZE) <= (KV_MAX_KEYS + 1U))) {
+    return kStatus_InvalidArgument;
+  }
+  flash = flashIf;
+  eraseCount = 0;
+
+  // The active sector is the valid one with the newest generation:
+  for (sector = 0; sector < flash->numSectors; sector++) {
+    header = page_at(sector * flash->sectorSize);
+    if (header_valid(header) &&
+	(!found || ((int32_t)(header->generation - generation) > 0))) {
+      activeSector = sector;
+      generation = header->generation;
+      found = true;
+    }
+  }
+
+  if (!found) {
+    // Empty store: make sector 0 active.
+    status = flash->erase(0);
+    eraseCount++;
+    if (status != kStatus_Success) {
+      return status;
+    }
+    memset(&pageBuf, 0xFF, KV_PAGE_SIZE);
+    pageBuf.header.magic = HEADER_MAGIC;
+    pageBuf.header.generation = 1U;
+    pageBuf.header.crc = crc32(&pageBuf.header, 2U * sizeof(uint32_t));
+    status = write_page(0);
+    if (status != kStatus_Success) {
+      return status;
+    }
+    activeSector = 0;
+    generation = 1U;
+  }
+
+  scan_sector();
+  return kStatus_Success;
+}
+
+
+int32_t kv_get(uint8_t key, void *value, uint32_t maxLen) {
+
+  const kv_record_t *record;
+
+  if ((flash == NULL) || (key >= KV_MAX_KEYS) ||
+      (recordOffset[key] == NO_RECORD)) {
+    return -1;
+  }
+  record = page_at(recordOffset[key]);
+  memcpy(value, record->data, (record->len < maxLen) ? record->len : maxLen);
+  return record->len;
+}
+
+
+status_t kv_put(uint8_t key, const void *value, uint32_t len) {
+
+  const kv_record_t *record;
+
+  if ((flash == NULL) || (key >= KV_MAX_KEYS) ||
+      (len == 0U) || (len > KV_MAX_VALUE_LEN)) {
+    return kStatus_InvalidArgument;
+  }
+
+  // Do not wear the flash for the same value:
+  if (recordOffset[key] != NO_RECORD) {
+    record = page_at(recordOffset[key]);
+    if ((record->len == len) && (memcmp(record->data, value, len) == 0)) {
+      return kStatus_Success;
+    }
+  }
+  return append(key, value, len);
+}
+
+
+status_t kv_delete(uint8_t key) {
+
+  if ((flash == NULL) || (key >= KV_MAX_KEYS)) {
+    return kStatus_InvalidArgument;
+  }
+  if (recordOffset[key] == NO_RECORD) {
+    return kStatus_Success;
+  }
+  return append(key, NULL, 0);
+}
+
+
+uint32_t kv_erase_count(void) {
+  return eraseCount;
+}
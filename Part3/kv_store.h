@@ -0,0 +1,67 @@
+// Small key/value store in flash, for calibration and configuration data
+// that must survive a reset.
+//
+// The store uses a few flash sectors reserved in LPC824_flash.ld.
+// Flash can only be written in pages of 64 bytes, and a page can be
+// written again only after its whole sector (1 kB) is erased. So the
+// store is a log: every kv_put() writes one new page (a "record") after
+// the last one. The newest record of a key is its value.
+//
+//  Sector: | header | record | record | ... | erased | erased |
+//
+// When the active sector is full, the next sector is erased and the
+// newest record of every key is copied into it. Its header is written
+// last: a sector becomes active only when the copy is complete. The
+// sectors are used in turn, so they are erased equally often
+// (wear levelling).
+//
+// Every header and record has a CRC32. If the power fails while a page is
+// written, its CRC is wrong and the page is ignored; the previous value of
+// the key is still valid.
+//
+// The flash is accessed only through a kv_flash_t, so the same code can
+// also run on a PC with an array in RAM as the "flash".
+
+#ifndef _KV_STORE_H_
+#define _KV_STORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fsl_common.h"
+
+#define KV_PAGE_SIZE 64U
+#define KV_MAX_KEYS 8U         // Keys are 0 .. KV_MAX_KEYS-1.
+#define KV_MAX_VALUE_LEN 56U   // Bytes of a value (one record per page).
+
+// Flash interface. Offsets are from the start of the store.
+typedef struct {
+  const uint8_t *mem;     // The store can be read directly from here.
+  uint32_t sectorSize;    // Bytes per erase sector.
+  uint32_t numSectors;    // At least 2.
+  // Set a whole sector to 0xFF:
+  status_t (*erase)(uint32_t sector);
+  // Write one page. offset is a multiple of KV_PAGE_SIZE, data is word aligned:
+  status_t (*program)(uint32_t offset, const uint32_t *data);
+} kv_flash_t;
+
+// Flash of the LPC824, written through the IAP ROM calls (kv_flash_iap.c).
+extern const kv_flash_t kvFlashIap;
+
+// Find the active sector and the newest record of every key.
+// Formats the store if there is no valid sector (first start).
+status_t kv_init(const kv_flash_t *flash);
+
+// Copy the value of key into value (at most maxLen bytes).
+// Returns the length of the value, or -1 if the key has no value.
+int32_t kv_get(uint8_t key, void *value, uint32_t maxLen);
+
+// Write a new value. Nothing is written if the value did not change.
+status_t kv_put(uint8_t key, const void *value, uint32_t len);
+
+// Remove the value of a key.
+status_t kv_delete(uint8_t key);
+
+// Number of sector erases since kv_init(), for checking the wear.
+uint32_t kv_erase_count(void);
+
+#endif // _KV_STORE_H_
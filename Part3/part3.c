@@ -17,9 +17,22 @@
 #include "fsl_power.h"
 #include "fsl_swm.h"
 #include "fsl_syscon.h"
+#include "cmd_uart.h"
+#include "uart_dma.h"
+#include "sig_stats.h"
+#include "spectral.h"
+#include "timebase.h"
+#include "deadline_mon.h"
+#include "kv_store.h"
+#include "protect.h"
+#include "spi_adc.h"
+#include "irq_prio.h"
+#include "defer.h"
+#include "i2c_async.h"
 #include <stdint.h>
 
 #define ADC_CHANNEL 1U  // Channel 1 will be used in this example.
+#define ADC_NUM_CHANNELS 12U // LPC824 ADC has channels 0..11.
 
 #define ADC_CLOCK_DIVIDER 1U // See Fig 52. ADC clocking in Ref Manual.
 
@@ -29,22 +42,322 @@
 #define CORE_CLOCK   30000000U  // Set CPU Core clock frequency (Hz)
 
 #define PWM_FREQUENCY_HZ      10000U   // 10 kHz
+#define PWM_CLOCK   CORE_CLOCK   // Counter L (PWM) is not prescaled.
+
+// The PWM is stopped by the hardware above this voltage (see protect.h):
+#define PROTECT_THRESHOLD_MV 2500U
+
+// Counter H triggers the ADC. Its prescaler is 8 bit; this value +1 is used.
+#define SCT_SAMPLE_PRESCALE 249U
+#define SCT_SAMPLE_CLOCK (CORE_CLOCK / (SCT_SAMPLE_PRESCALE + 1U)) // 120 kHz
+
+#define SAMPLE_RATE_HZ      12U     // Default ADC sampling rate.
+#define SAMPLE_RATE_MAX_HZ  20000U  // Upper limit for "set rate".
+
+// Where the samples come from. Can be changed with "set src".
+#define ADC_SOURCE_INTERNAL 0U  // On-chip ADC, triggered by SCT OUT3.
+#define ADC_SOURCE_SPI 1U       // External SPI ADC (see spi_adc.h).
+
+// External SPI ADC: a 16 bit SAR ADC with a conversion start (CNV) pin.
+#define SPI_ADC_SCK_HZ        15000000U
+#define SPI_ADC_CONVERSION_NS     2200U
+#define SPI_ADC_RATE_HZ         100000U  // Rate when "set src 1" is given.
+#define SPI_ADC_CHANNEL 0U  // Its samples are sent as this channel.
+#define SPI_ADC_RAW_PRINT_MS 100U // RAW mode: at most one line per 100 ms.
+
+// Sensors on I2C0, read by polling jobs (see i2c_async.h).
+// If a sensor is not fitted, its NACKs are only counted ("get i2c_err").
+#define SENSOR_I2C_BUS 0U
+#define SENSOR_I2C_HZ 100000U
+#define TEMP_SENSOR_ADDR 0x48U   // LM75 type temperature sensor, A2..A0 = 0.
+#define TEMP_POLL_MS 250U
+
+// What the ADC ISR sends to the serial port. Can be changed with "set mode".
+#define TELEMETRY_OFF 0U  // Nothing, acquisition continues.
+#define TELEMETRY_RAW 1U  // Every sample.
+#define TELEMETRY_BINARY 2U // Every sample, in binary frames sent by DMA.
+#define TELEMETRY_STATS 3U  // Statistics of each window (see sig_stats.h).
+#define TELEMETRY_SPECTRUM 4U // FFT and tones of each block (see spectral.h).
+
+// Spectrum mode uses blocks of the lowest channel in the channel mask.
+#define SPECTRAL_BLOCK_LEN 128U   // 64, 128 or 256.
+#define SPECTRAL_BAND_FIRST 8U    // Bins of the band whose energy is sent.
+#define SPECTRAL_BAND_LAST  16U
+
+// Binary telemetry frame: a sync word, then TELEMETRY_BLOCK_LEN samples.
+// Each sample is a 16 bit little endian word: (channel << 12) | result.
+#define TELEMETRY_BLOCK_LEN 32U
+#define TELEMETRY_SYNC 0xA55AU
+
+// Deadline monitor (see deadline_mon.h). The ADC ISR may use half of the
+// sampling period; the main loop must come around every 100 ms.
+// The other activities (ids in this order, see "get stalled"):
+//  - spi: each SPI ADC block in the main loop, half of the block time.
+//  - dma: the DMA ISR when a telemetry frame is sent, and
+//  - defer: the deferred work in PendSV. Both run at irregular times,
+//    so only their budget is checked (period 0).
+//  - i2c: the millisecond work of the sensor bus in its I2C interrupt.
+#define MAIN_LOOP_PERIOD_US 100000U
+#define MAIN_LOOP_BUDGET_US  50000U
+#define DMA_DONE_BUDGET_US      50U
+#define DEFER_BUDGET_US      10000U  // Includes waiting for CONSOLE_PRINTF.
+#define I2C_TICK_PERIOD_US    1000U
+#define I2C_TICK_BUDGET_US     100U
+#define WATCHDOG_TIMEOUT_MS   1000U
+
+// Keys in the flash store (see kv_store.h):
+#define KV_KEY_CONFIG 0U   // saved_config_t, written by "set save 1".
 
 
 // The pointer and flag are global so that ISR can manipulate them:
 adc_result_info_t *volatile ADCResultPtr; 
 volatile bool ADCConvCompleteFlag; //Global flag for signalling between main and ISR
 
+// Run time configuration. These can be changed through the serial port
+// while the program is running (see cmd_uart.h):
+static volatile uint32_t sampleRateHz   = SAMPLE_RATE_HZ;
+static volatile uint32_t channelMask    = (1U << ADC_CHANNEL);
+static volatile uint32_t pwmFrequencyHz = PWM_FREQUENCY_HZ;
+static volatile uint32_t pwmDutyPercent;
+static volatile uint32_t telemetryMode  = TELEMETRY_RAW;
+static uint32_t adcSource = ADC_SOURCE_INTERNAL;
+static uint32_t internalRateHz = SAMPLE_RATE_HZ; // Kept while the SPI ADC runs.
+
+static const spi_adc_config_t spiAdcConfig = {
+  .format = { .frameBits = 16U, .dataBits = 16U, .dataShift = 0U },
+  .spiClockHz = SPI_ADC_SCK_HZ,
+  .conversionNs = SPI_ADC_CONVERSION_NS,
+  .clockIdleHigh = false,     // SPI mode 0.
+  .sampleSecondEdge = false,
+};
+
+// SCT event numbers, needed to find the match registers later:
+static uint32_t adcTriggerEvent; // Counter H: toggles OUT3, triggers ADC.
+static uint32_t pwmEvent;        // Counter L: PWM period (pulse is +1).
+
+// Two binary frames: the ISR fills one while the DMA sends the other.
+typedef struct {
+  uint16_t sync;
+  uint16_t sample[TELEMETRY_BLOCK_LEN];
+} telemetry_frame_t;
+
+static telemetry_frame_t txFrame[2];
+static volatile bool txFrameBusy[2]; // true until the DMA has sent it.
+static uint8_t txFrameFill;          // Frame being filled by the ISR.
+static uint8_t txSampleCount;        // Samples in that frame.
+static volatile uint32_t telemetryDropped; // Samples lost, DMA too slow.
+
+static uart_baud_config_t baudConfig; // Actual USART0 baud rate.
+
+// Run time configuration as saved in flash. Loaded at start up.
+typedef struct {
+  uint32_t sampleRateHz;
+  uint32_t channelMask;
+  uint32_t pwmFrequencyHz;
+  uint32_t pwmDutyPercent;
+  uint32_t telemetryMode;
+  uint32_t statsWindow;
+  uint32_t baudrate;
+  uint32_t tripThresholdMv;
+} saved_config_t;
+
+static uint8_t adcDeadline = DEADLINE_INVALID;  // Deadline monitor ids.
+static uint8_t mainDeadline = DEADLINE_INVALID;
+static uint8_t spiDeadline = DEADLINE_INVALID;
+
+// Two sample blocks for the spectrum: the ISR fills one while the
+// deferred work (PendSV) analyses the other.
+static int16_t spectrumBlock[2][SPECTRAL_BLOCK_LEN];
+static int16_t spectrumIm[SPECTRAL_BLOCK_LEN];   // Imaginary part for FFT.
+static volatile bool spectrumBusy[2]; // true: full, waiting for analysis.
+static uint8_t spectrumFill;
+static uint32_t spectrumCount;
+static volatile uint32_t spectrumDropped; // Samples lost, analysis too slow.
+
+// Temperature sensor: write the register number 0, read 2 bytes.
+static const uint8_t tempRegister = 0x00U;
+static uint8_t tempData[2];
+static volatile uint32_t temperatureDeci; // 0.1 C; 0 below 0 C.
+static void temp_read_done(i2c_xfer_t *xfer);
+static i2c_xfer_t tempXfer = {
+  .addr = TEMP_SENSOR_ADDR,
+  .txLen = 1, .tx = &tempRegister,
+  .rxLen = 2, .rx = tempData,
+  .done = temp_read_done,
+};
+
+// Results of the last conversion in RAW mode, printed by the deferred work.
+static volatile uint16_t rawResult[ADC_NUM_CHANNELS];
+static volatile bool rawPending;      // true: not printed yet.
+
+// Goertzel tone detector bins: bin k is at k * rate / SPECTRAL_BLOCK_LEN Hz.
+static const uint16_t toneBins[] = { 4, 10, 25 };
+#define NUM_TONES (sizeof(toneBins) / sizeof(toneBins[0]))
+
 void clock_init(void);
 status_t uart_init(void);
 void adc_init(void);
 void ADC_Configuration(adc_result_info_t * ADCResultStruct);
 void SCT_Configuration(void);
+bool sct_set_sample_rate(uint32_t rate_hz);
+bool sct_set_pwm(uint32_t frequency_hz, uint32_t duty_percent);
+bool adc_set_channels(uint32_t mask);
+bool adc_set_source(uint32_t source);
+void spi_block_process(void);
+void telemetry_put(uint32_t channel, uint32_t result);
+void stats_report(void);
+void spectrum_put(uint32_t result);
+static void spectrum_analyse(uint32_t block);
+static void raw_print(uint32_t mask);
+bool config_load(void);
+bool config_save(uint32_t save);
 int result1 = 0;
+
+
+// Parameter table for the serial command interface.
+// Each parameter has a get and a set function:
+static uint32_t get_rate(void) { return sampleRateHz; }
+static uint32_t get_channels(void) { return channelMask; }
+static uint32_t get_pwm(void) { return pwmFrequencyHz; }
+static uint32_t get_duty(void) { return pwmDutyPercent; }
+static uint32_t get_mode(void) { return telemetryMode; }
+static uint32_t get_baud(void) { return baudConfig.baudrate; }
+static uint32_t get_baud_err(void) {
+  return (baudConfig.errorPpm < 0) ? -baudConfig.errorPpm : baudConfig.errorPpm;
+}
+static uint32_t get_dropped(void) {
+  return telemetryDropped + spectrumDropped +
+	 (spi_adc_overruns() * SPI_ADC_BLOCK_LEN);
+}
+static uint32_t get_rx_drop(void) { return cmd_uart_dropped(); }
+static uint32_t get_window(void) { return sig_stats_get_window(); }
+static uint32_t get_win_lost(void) { return sig_stats_overwritten(); }
+static uint32_t get_overruns(void) { return deadline_total_overruns(); }
+static uint32_t get_late(void) { return deadline_total_late(); }
+static uint32_t get_stalled(void) { return deadline_late_mask(); }
+static uint32_t get_max_exec(uint8_t id) {
+  deadline_info_t info;
+  return deadline_get_info(id, &info) ? info.maxExecUs : 0U;
+}
+static uint32_t get_exec_adc(void) { return get_max_exec(adcDeadline); }
+static uint32_t get_exec_main(void) { return get_max_exec(mainDeadline); }
+static uint32_t get_source(void) { return adcSource; }
+static uint32_t get_trip_mv(void) { return protect_get_threshold_mv(); }
+static uint32_t get_trips(void) {
+  protect_stats_t stats;
+  protect_get_stats(&stats);
+  return stats.trips;
+}
+static uint32_t get_trip(void) {
+  protect_stats_t stats;
+  protect_get_stats(&stats);
+  return stats.state;
+}
+static uint32_t get_latency(uint32_t level) {
+  irq_latency_t latency;
+  irq_prio_get_latency(level, &latency);
+  return latency.maxCycles;
+}
+static uint32_t get_lat0(void) { return get_latency(IRQ_PRIO_CAPTURE); }
+static uint32_t get_lat1(void) { return get_latency(IRQ_PRIO_STREAM); }
+static uint32_t get_lat2(void) { return get_latency(IRQ_PRIO_LOG); }
+static uint32_t get_lat3(void) { return get_latency(IRQ_PRIO_DEFERRED); }
+static uint32_t get_defer_wait(void) {
+  defer_stats_t stats;
+  defer_get_stats(&stats);
+  return stats.maxWaitCycles;
+}
+static uint32_t get_defer_drop(void) {
+  defer_stats_t stats;
+  defer_get_stats(&stats);
+  return stats.dropped;
+}
+static uint32_t get_i2c_util(void) {
+  return i2c_async_utilisation(SENSOR_I2C_BUS);
+}
+static uint32_t get_i2c_late(void) { return i2c_job_overruns(); }
+static uint32_t get_i2c_err(void) {
+  i2c_bus_stats_t stats;
+  i2c_async_get_stats(SENSOR_I2C_BUS, &stats);
+  return stats.nackAddr + stats.nackData + stats.arbLost +
+	 stats.busErrors + stats.timeouts;
+}
+static uint32_t get_temp(void) { return temperatureDeci; }
+static uint32_t get_erases(void) { return kv_erase_count(); }
+static uint32_t get_save(void) {
+  saved_config_t config;
+  return (kv_get(KV_KEY_CONFIG, &config, sizeof(config)) > 0) ? 1U : 0U;
+}
+
+static bool set_rate(uint32_t value) {
+  if (adcSource == ADC_SOURCE_SPI) {
+    if (spi_adc_start(value) != kStatus_Success) {
+      return false;
+    }
+    sampleRateHz = spi_adc_rate();
+    return true;
+  }
+  return sct_set_sample_rate(value);
+}
+static bool set_pwm(uint32_t value) { return sct_set_pwm(value, pwmDutyPercent); }
+static bool set_duty(uint32_t value) { return sct_set_pwm(pwmFrequencyHz, value); }
+static bool set_mode(uint32_t value) {
+  if (value > TELEMETRY_SPECTRUM) {
+    return false;
+  }
+  telemetryMode = value;
+  return true;
+}
+// "set trip 0": restart the PWM after a latched trip.
+static bool set_trip(uint32_t value) {
+  return (value == 0U) && protect_rearm();
+}
+// The reply to "set baud" is already sent with the new baud rate.
+static bool set_baud(uint32_t value) {
+  return (uart_dma_set_baud(CLOCK_GetMainClkFreq(), value, &baudConfig) ==
+	  kStatus_Success);
+}
+
+static const cmd_param_t cmdParams[] = {
+  { "rate", get_rate,     set_rate },            // ADC sampling rate (Hz)
+  { "ch",   get_channels, adc_set_channels },    // ADC channel mask
+  { "pwm",  get_pwm,      set_pwm },             // PWM frequency (Hz)
+  { "duty", get_duty,     set_duty },            // PWM duty cycle (%)
+  { "mode", get_mode,     set_mode },            // Telemetry mode
+  { "src",  get_source,   adc_set_source },      // 0: on-chip ADC, 1: SPI ADC
+  { "baud", get_baud,     set_baud },            // USART0 baud rate
+  { "baud_err", get_baud_err, NULL },            // Baud rate error (ppm)
+  { "dropped",  get_dropped,  NULL },            // Lost binary/spectrum samples
+  { "rx_drop",  get_rx_drop,  NULL },            // Lost command characters
+  { "window", get_window, sig_stats_set_window }, // Samples per statistics window
+  { "win_lost", get_win_lost, NULL },            // Windows not read in time
+  { "overruns", get_overruns, NULL },            // Budget overruns (all tasks)
+  { "late",     get_late,     NULL },            // Late periods (all tasks)
+  { "stalled",  get_stalled,  NULL },            // Bit mask: 1 adc, 2 main, 4 spi, 8 dma, 16 defer, 32 i2c
+  { "exec_adc", get_exec_adc, NULL },            // Longest ADC ISR work (us)
+  { "exec_main", get_exec_main, NULL },          // Longest main loop pass (us)
+  { "trip_mv",  get_trip_mv,  protect_set_threshold_mv }, // Trip voltage (mV)
+  { "trips",    get_trips,    NULL },            // Number of trips
+  { "trip",     get_trip,     set_trip },        // protect_state_t; set 0: rearm
+  { "save",     get_save,     config_save },     // 1: save to flash, 0: forget
+  { "erases",   get_erases,   NULL },            // Flash sector erases since start
+  { "lat0",     get_lat0,     NULL },            // Max IRQ latency (cycles)
+  { "lat1",     get_lat1,     NULL },            //  at priority levels 0..3
+  { "lat2",     get_lat2,     NULL },            //  (see irq_prio.h)
+  { "lat3",     get_lat3,     NULL },
+  { "defer_wait", get_defer_wait, NULL },        // Max post-to-run (cycles)
+  { "defer_drop", get_defer_drop, NULL },        // Work lost, queue full
+  { "i2c_util", get_i2c_util, NULL },            // Sensor bus busy (per mille)
+  { "i2c_err",  get_i2c_err,  NULL },            // NACK, bus errors, timeouts
+  { "i2c_late", get_i2c_late, NULL },            // Jobs skipped, previous not done
+  { "temp",     get_temp,     NULL },            // Temperature (0.1 C)
+};
+
 int main(void) {
   
   uint32_t frequency = 0U;
   adc_result_info_t ADCResultStruct;
+  const char *stalled;
 
   // The global pointer is made to point to this local variable
   // &ADCResultStruct is the memory address where ADCResultStruct is kept.
@@ -54,9 +367,28 @@ int main(void) {
 
   InitPins();
   clock_init();
+  timebase_init(CORE_CLOCK); // SysTick: ms ticks and cycle counts.
+  irq_prio_init();           // Before any interrupt is enabled.
   uart_init();
+  uart_dma_init(); // DMA transmit queue for binary telemetry.
+  sig_stats_init(SIG_STATS_WINDOW_DEFAULT);
   
-  PRINTF("ADC interrupt example.\r\n");
+  CONSOLE_PRINTF("ADC interrupt example.\r\n");
+
+  stalled = deadline_last_reset();
+  if (stalled != NULL) {
+    CONSOLE_PRINTF("Watchdog reset! Stalled task: %s\r\n", stalled);
+  }
+  adcDeadline = deadline_register("adc", 1000000U / sampleRateHz,
+				  500000U / sampleRateHz);
+  mainDeadline = deadline_register("main", MAIN_LOOP_PERIOD_US,
+				   MAIN_LOOP_BUDGET_US);
+  spiDeadline = deadline_register("spi", 0, 0);  // Set when the SPI ADC runs.
+  uart_dma_set_deadline(deadline_register("dma", 0, DMA_DONE_BUDGET_US));
+  defer_set_deadline(deadline_register("defer", 0, DEFER_BUDGET_US));
+  i2c_async_set_deadline(SENSOR_I2C_BUS,
+			 deadline_register("i2c", I2C_TICK_PERIOD_US,
+					   I2C_TICK_BUDGET_US));
 
   SCT_Configuration();  // Initialize SCT timer for periodic timing.
 
@@ -67,12 +399,22 @@ int main(void) {
   // Enable the interrupt the for Sequence A Conversion Complete:
   ADC_EnableInterrupts(ADC0, kADC_ConvSeqAInterruptEnable); // Within ADC0
   NVIC_EnableIRQ(ADC0_SEQA_IRQn);                           // Within NVIC
+
+  // Replace the defaults with the configuration saved in flash, if any:
+  if (config_load()) {
+    CONSOLE_PRINTF("Saved configuration loaded.\r\n");
+  }
+
+  // Sensor polling runs in the background from now on:
+  if (i2c_async_init(SENSOR_I2C_BUS, SENSOR_I2C_HZ) == kStatus_Success) {
+    i2c_job_add(SENSOR_I2C_BUS, &tempXfer, TEMP_POLL_MS);
+  }
   
-  PRINTF("Configuration Done.\r\n\n");
+  CONSOLE_PRINTF("Configuration Done.\r\n\n");
 
   
     /*
-     * The main loop is completely empty.
+     * The main loop only reads commands from the serial port.
      * All ADC conversion is handled by the hardware.
      *
      * ADC0 conversion is triggered by the hardware: SCT OUTPUT 3 event
@@ -87,34 +429,26 @@ int main(void) {
      * 1. The main loop is free to do other tasks.
      * 2. The sampling time of the analog channels is precise.
      *
+     * Sampling rate, channels, PWM and telemetry can be changed from the
+     * terminal without stopping the acquisition, e.g.:
+     *   set rate 100
+     *   set ch 0x6
+     *   get
     */
-    uint32_t sctimerClock = CORE_CLOCK;   // 30 MHz
-
-    // 4) SCTimer konfig
-    sctimer_config_t sctimerConfig;
-    SCTIMER_GetDefaultConfig(&sctimerConfig);
-    SCTIMER_Init(SCT0, &sctimerConfig);
-
-    // 5) PWM parametreleri (tek çıkış)
-    sctimer_pwm_signal_param_t ledPwmParam;
-    ledPwmParam.output           = kSCTIMER_Out_4;        // OUT4 → LED pini
-    ledPwmParam.level            = kSCTIMER_HighTrue;     // HIGH iken LED aktif
-    ledPwmParam.dutyCyclePercent = result1;      // %10 duty
-
-    uint32_t event0;
-
-    // 6) PWM’i ayarla (edge-aligned veya center fark etmez, ben edge kullandım)
-    SCTIMER_SetupPwm(SCT0,
-                     &ledPwmParam,
-                     kSCTIMER_EdgeAlignedPwm,
-                     PWM_FREQUENCY_HZ,
-                     sctimerClock,
-                     &event0);
-
-    // 7) Timer’ı başlat
-    SCTIMER_StartTimer(SCT0, kSCTIMER_Counter_U);
+  // Serial commands can now change the configuration at run time:
+  cmd_uart_init(cmdParams, sizeof(cmdParams) / sizeof(cmdParams[0]));
+
+  // From now on the main loop must not stall, or the chip is reset:
+  deadline_watchdog_init(WATCHDOG_TIMEOUT_MS);
+
   while (1) {
-    
+    deadline_begin(mainDeadline);
+    cmd_uart_poll();
+    stats_report();
+    spi_block_process();   // Samples of the SPI ADC, if it runs.
+    protect_poll();        // Restarts the PWM after a trip.
+    deadline_end(mainDeadline);
+    deadline_supervise();  // Feeds the watchdog if no task is late.
   } 
 
   
@@ -127,17 +461,45 @@ void ADC0_SEQA_IRQHandler(void) {
     if (kADC_ConvSeqAInterruptFlag ==
 	(kADC_ConvSeqAInterruptFlag & ADC_GetStatusFlags(ADC0))) {
 
-      ADC_GetChannelConversionResult(ADC0, ADC_CHANNEL, ADCResultPtr);
+      uint32_t mask = channelMask;
+      uint32_t ch;
+      uint32_t rawMask = 0;
+      bool firstChannel = true;
 
+      deadline_begin(adcDeadline);
       ADC_ClearStatusFlags(ADC0, kADC_ConvSeqAInterruptFlag);
-	  result1 = 0.02442*(ADCResultPtr->result);
-      PRINTF("Ch %d result = %d    \r", // See below for PRINTF usage in an ISR.
-	     ADCResultPtr->channelNumber,
-	     result1);
+
+      // Every channel in the sequence has its own result register:
+      for (ch = 0; ch < ADC_NUM_CHANNELS; ch++) {
+	if (((mask & (1U << ch)) == 0U) ||
+	    !ADC_GetChannelConversionResult(ADC0, ch, ADCResultPtr)) {
+	  continue;
+	}
+	result1 = 0.02442*(ADCResultPtr->result);
+	if (telemetryMode == TELEMETRY_BINARY) {
+	  telemetry_put(ch, ADCResultPtr->result);
+	} else if (telemetryMode == TELEMETRY_STATS) {
+	  sig_stats_add(ch, ADCResultPtr->result);
+	} else if (telemetryMode == TELEMETRY_SPECTRUM) {
+	  if (firstChannel) {
+	    spectrum_put(ADCResultPtr->result);
+	  }
+	} else if ((telemetryMode == TELEMETRY_RAW) && !rawPending) {
+	  rawResult[ch] = result1;  // Printed later; see below.
+	  rawMask |= (1U << ch);
+	}
+	firstChannel = false;
+      }
+      if (rawMask != 0U) {
+	rawPending = true;
+	if (!defer_post(raw_print, rawMask)) {
+	  rawPending = false;
+	}
+      }
 
       /*
       // ignore this part. It is for demo using SerialPlot:
-      PRINTF("%d\r\n", // See below for PRINTF usage in an ISR.
+      CONSOLE_PRINTF("%d\r\n", // See below for PRINTF usage in an ISR.
 	     //ADCResultPtr->channelNumber,
 	     ADCResultPtr->result);
       */
@@ -147,6 +509,7 @@ void ADC0_SEQA_IRQHandler(void) {
       //  ADC conversion, that task can check this flag;
       //  when the flag is true,  the task can use the conversion result:
       ADCConvCompleteFlag = true; 
+      deadline_end(adcDeadline);
     }
 }
 
@@ -155,13 +518,200 @@ void ADC0_SEQA_IRQHandler(void) {
 // as quickly as possible.
 // PRINTF is a function that may take a long time to execute.
 // So it is not advisable to use PRINTF in an ISR.
-// However, PRINTF is used in an ISR here to
-//  emphasize that the main loop is not doing anything.
+// The ADC ISR only keeps the results, and posts raw_print() to the
+// deferred work (defer.h). It runs in PendSV at the lowest priority, so
+// the next conversions are not delayed by the PRINTF.
+// While a line is waiting to be printed, new results are not kept.
+static void raw_print(uint32_t mask) {
+
+  uint32_t ch;
+
+  for (ch = 0; ch < ADC_NUM_CHANNELS; ch++) {
+    if ((mask & (1U << ch)) != 0U) {
+      CONSOLE_PRINTF("Ch %d result = %d    ", ch, rawResult[ch]);
+    }
+  }
+  CONSOLE_PRINTF("\r");
+  rawPending = false;
+}
 
 
 
 
+// Called by the DMA ISR when a binary frame has been sent.
+static void telemetry_frame_sent(const uint8_t *data, uint16_t len,
+				 void *userData) {
+  *(volatile bool *)userData = false;  // Frame can be filled again.
+}
+
+// Add one sample to the binary telemetry frame (called from the ADC ISR).
+// A full frame is given to the DMA, and the other frame is filled next.
+void telemetry_put(uint32_t channel, uint32_t result) {
+
+  telemetry_frame_t *frame = &txFrame[txFrameFill];
+
+  if (txFrameBusy[txFrameFill]) {
+    telemetryDropped++;   // The DMA has not finished this frame yet.
+    return;
+  }
+
+  frame->sample[txSampleCount++] = (uint16_t)((channel << 12) | (result & 0xFFFU));
+
+  if (txSampleCount == TELEMETRY_BLOCK_LEN) {
+    frame->sync = TELEMETRY_SYNC;
+    txFrameBusy[txFrameFill] = true;
+    if (uart_dma_send((const uint8_t *)frame, sizeof(*frame),
+		      telemetry_frame_sent,
+		      (void *)&txFrameBusy[txFrameFill]) != kStatus_Success) {
+      txFrameBusy[txFrameFill] = false;
+      telemetryDropped += TELEMETRY_BLOCK_LEN;
+    }
+    txFrameFill ^= 1U;
+    txSampleCount = 0;
+  }
+}
+
+
+
+// Print the statistics of the windows completed since the last call.
+// Called from the main loop: one line per channel per window.
+void stats_report(void) {
+
+  sig_stats_result_t stats;
+  uint32_t ch;
+
+  for (ch = 0; ch < ADC_NUM_CHANNELS; ch++) {
+    if (sig_stats_read(ch, &stats)) {
+      CONSOLE_PRINTF("Ch %d n=%d min=%d max=%d pp=%d mean=%d rms=%d var=%d\r\n",
+	     ch, stats.count, stats.min, stats.max, stats.peakToPeak,
+	     stats.mean, stats.rms, stats.variance);
+    }
+  }
+}
+
+
+
+// Add one sample to the spectrum block (called from the ADC ISR).
+void spectrum_put(uint32_t result) {
+
+  if (spectrumBusy[spectrumFill]) {
+    spectrumDropped++;   // Both blocks are waiting for the analysis.
+    return;
+  }
+
+  spectrumBlock[spectrumFill][spectrumCount++] = spectral_from_adc(result);
+
+  if (spectrumCount == SPECTRAL_BLOCK_LEN) {
+    spectrumBusy[spectrumFill] = true;  // Give it to the deferred work.
+    if (!defer_post(spectrum_analyse, spectrumFill)) {
+      spectrumBusy[spectrumFill] = false;
+      spectrumDropped += SPECTRAL_BLOCK_LEN;
+    }
+    spectrumFill ^= 1U;
+    spectrumCount = 0;
+  }
+}
+
+
+// Analyse one full spectrum block (deferred work, posted by spectrum_put).
+// The Goertzel bins are calculated first, because the FFT overwrites
+// the samples. The cycle counts of both are printed.
+static void spectrum_analyse(uint32_t b) {
+
+  uint32_t tonePower[NUM_TONES];
+  uint32_t i, peak;
+  uint32_t t0, t1, t2;
+  int16_t *x = spectrumBlock[b];
+
+  t0 = timebase_cycles();
+  spectral_goertzel_bins(x, SPECTRAL_BLOCK_LEN, toneBins, NUM_TONES, tonePower);
+  t1 = timebase_cycles();
+  spectral_fft(x, spectrumIm, SPECTRAL_BLOCK_LEN);
+  t2 = timebase_cycles();
+
+  peak = spectral_peak_bin(x, spectrumIm, SPECTRAL_BLOCK_LEN);
+  CONSOLE_PRINTF("FFT n=%d peak=%d Hz power=%d band=%d cycles fft=%d goertzel=%d\r\n",
+	 SPECTRAL_BLOCK_LEN,
+	 (peak * sampleRateHz) / SPECTRAL_BLOCK_LEN,
+	 spectral_power(x, spectrumIm, peak),
+	 (uint32_t)spectral_band_energy(x, spectrumIm,
+					SPECTRAL_BAND_FIRST, SPECTRAL_BAND_LAST),
+	 t2 - t1, t1 - t0);
+  for (i = 0; i < NUM_TONES; i++) {
+    CONSOLE_PRINTF("  tone %d Hz power=%d\r\n",
+	   (toneBins[i] * sampleRateHz) / SPECTRAL_BLOCK_LEN, tonePower[i]);
+  }
+
+  spectrumBusy[b] = false;   // The ISR may fill it again.
+}
+
+
+
+// Temperature sensor read (called in the I2C interrupt).
+// The register is 9 bits, left aligned, in 0.5 C steps.
+static void temp_read_done(i2c_xfer_t *xfer) {
+
+  int16_t raw;
+
+  if (xfer->status != kI2cXfer_Done) {
+    return;   // Counted in the bus statistics.
+  }
+  raw = (int16_t)((tempData[0] << 8) | tempData[1]) / 128;
+  temperatureDeci = (raw > 0) ? ((uint32_t)raw * 5U) : 0U;
+}
+
+
+// Read the configuration saved in flash and apply it.
+// Returns false if nothing was saved. Values that are not valid any more
+// are ignored by the set functions, and the default stays.
+bool config_load(void) {
+
+  saved_config_t config;
+
+  if ((kv_init(&kvFlashIap) != kStatus_Success) ||
+      (kv_get(KV_KEY_CONFIG, &config, sizeof(config)) != (int32_t)sizeof(config))) {
+    return false;
+  }
+  sct_set_sample_rate(config.sampleRateHz);
+  adc_set_channels(config.channelMask);
+  sct_set_pwm(config.pwmFrequencyHz, config.pwmDutyPercent);
+  set_mode(config.telemetryMode);
+  sig_stats_set_window(config.statsWindow);
+  protect_set_threshold_mv(config.tripThresholdMv);
+  set_baud(config.baudrate);  // Last: PRINTF uses the new rate from now on.
+  return true;
+}
+
+
+// "set save 1": write the current configuration to flash.
+// "set save 0": delete it; the defaults are used after the next reset.
+// Interrupts are disabled while the flash is written (see kv_flash_iap.c).
+bool config_save(uint32_t save) {
+
+  saved_config_t config;
+
+  if (save == 0U) {
+    return kv_delete(KV_KEY_CONFIG) == kStatus_Success;
+  }
+  if (save != 1U) {
+    return false;
+  }
+  config.sampleRateHz   = sampleRateHz;
+  config.channelMask    = channelMask;
+  config.pwmFrequencyHz = pwmFrequencyHz;
+  config.pwmDutyPercent = pwmDutyPercent;
+  config.telemetryMode  = telemetryMode;
+  config.statsWindow    = sig_stats_get_window();
+  config.baudrate       = baudConfig.baudrate;
+  config.tripThresholdMv = protect_get_threshold_mv();
+  return kv_put(KV_KEY_CONFIG, &config, sizeof(config)) == kStatus_Success;
+}
+
+
+
 // ADC clock and power are turned on and initiali calibration is performed.
+// The calibration result can not be read from the ADC, so it can not be
+// saved in flash: it is done again at every start.
 void adc_init(void){
 
   uint32_t frequency = 0U;
@@ -175,9 +725,9 @@ void adc_init(void){
   frequency = CLOCK_GetFreq(kCLOCK_Irc);
 
   if (true == ADC_DoSelfCalibration(ADC0, frequency)) {
-    PRINTF("ADC Calibration Done.\r\n");
+    CONSOLE_PRINTF("ADC Calibration Done.\r\n");
   } else {
-    PRINTF("ADC Calibration Failed.\r\n");
+    CONSOLE_PRINTF("ADC Calibration Failed.\r\n");
   }
   
 }
@@ -198,7 +748,7 @@ void ADC_Configuration(adc_result_info_t * ADCResultStruct) {
   
   // Insert this channel in Sequence A, and set conversion properties:
   // See Sec: 21.6.2 A/D Conversion Sequence A Control Register
-  adcConvSeqConfigStruct.channelMask = (1U << ADC_CHANNEL); 
+  adcConvSeqConfigStruct.channelMask = channelMask; 
 
   // Triggered by SCT OUT3 event. See Table 277. "ADC hardware trigger inputs":
   adcConvSeqConfigStruct.triggerMask      = 3U;
@@ -226,12 +776,17 @@ void ADC_Configuration(adc_result_info_t * ADCResultStruct) {
 
 
 
+// The SCT is used as two 16 bit timers:
+//  Counter L generates the PWM on OUT4.
+//  Counter H toggles OUT3, which triggers the ADC (see ADC_Configuration).
+// Both are set up here with a single SCTIMER_Init() call; a second call
+// would reset the SCT and delete the events of the other counter.
 void SCT_Configuration(void){
 
   
   sctimer_config_t sctimerConfig;
-  uint32_t eventCounterL;
-  uint16_t matchValueL;
+  sctimer_pwm_signal_param_t ledPwmParam;
+  uint16_t matchValueH;
   
   CLOCK_EnableClock(kCLOCK_Sct);      // Enable clock of sct.
 
@@ -244,43 +799,259 @@ void SCT_Configuration(void){
   sctimerConfig.clockMode = kSCTIMER_System_ClockMode; // Use system clock as SCT input
 
 
-  matchValueL= 5000; // This is in: 16.6.20 SCT match registers 0 to 7
-  sctimerConfig.enableBidirection_l= false; // Use as single directional register.
+  // OUT3 toggles once per period and the ADC starts at its rising edge,
+  // so one sample takes two periods of counter H:
+  matchValueH = (SCT_SAMPLE_CLOCK / (2U * SAMPLE_RATE_HZ)) - 1U; // 16.6.20 SCT match registers 0 to 7
+  sctimerConfig.enableBidirection_h= false; // Use as single directional register.
   // Prescaler is 8 bit, in: CTRL. See: 16.6.3 SCT control register
-  sctimerConfig.prescale_l = 249; // Thi value +1 is used.
+  sctimerConfig.prescale_h = SCT_SAMPLE_PRESCALE; // Thi value +1 is used.
 
+  sctimerConfig.enableBidirection_l= false; // PWM counter counts up only.
+  sctimerConfig.prescale_l = 0;             // PWM counter runs at CORE_CLOCK.
   
   SCTIMER_Init(SCT0, &sctimerConfig);    // Initialize SCTimer module
   
 
-  // Configure the low side counter.
-  // Schedule a match event for the 16-bit low counter:
+  // Configure the high side counter.
+  // Schedule a match event for the 16-bit high counter:
   SCTIMER_CreateAndScheduleEvent(SCT0,
 				 kSCTIMER_MatchEventOnly,
-				 matchValueL,
+				 matchValueH,
 				 0,    // Not used for "Match Only"
-				 kSCTIMER_Counter_L,
-				 &eventCounterL);
+				 kSCTIMER_Counter_H,
+				 &adcTriggerEvent);
 
   // TODO: Rather than toggle, it should set the output:
-  // Toggle output_3 when the 16-bit low counter event occurs:
-  SCTIMER_SetupOutputToggleAction(SCT0, kSCTIMER_Out_3, eventCounterL);
+  // Toggle output_3 when the 16-bit high counter event occurs:
+  SCTIMER_SetupOutputToggleAction(SCT0, kSCTIMER_Out_3, adcTriggerEvent);
   
-  // Reset Counter L when the 16-bit low counter event occurs
-  SCTIMER_SetupCounterLimitAction(SCT0, kSCTIMER_Counter_L, eventCounterL);
+  // Reset Counter H when the 16-bit high counter event occurs
+  SCTIMER_SetupCounterLimitAction(SCT0, kSCTIMER_Counter_H, adcTriggerEvent);
   
-  // Setup the 16-bit low counter event active direction
+  // Setup the 16-bit high counter event active direction
   //  See fsl_sctimer.h
   SCTIMER_SetupEventActiveDirection(SCT0,
 				    kSCTIMER_ActiveIndependent,
-				    eventCounterL);
+				    adcTriggerEvent);
   
+
+  // PWM parametreleri (tek çıkış)
+  ledPwmParam.output           = kSCTIMER_Out_4;        // OUT4 → LED pini
+  ledPwmParam.level            = kSCTIMER_HighTrue;     // HIGH iken LED aktif
+  ledPwmParam.dutyCyclePercent = result1;
+  pwmDutyPercent = result1;
+
+  // PWM’i ayarla (edge-aligned). In split mode it uses counter L.
+  SCTIMER_SetupPwm(SCT0,
+		   &ledPwmParam,
+		   kSCTIMER_EdgeAlignedPwm,
+		   PWM_FREQUENCY_HZ,
+		   PWM_CLOCK,
+		   &pwmEvent);
+
+
+  // External SPI ADC: its events on counter H stay off until "set src 1".
+  spi_adc_init(&spiAdcConfig, CORE_CLOCK);
+
+  // Comparator trip: halts counter L and clears OUT4 in hardware.
+  protect_init(kSCTIMER_Out_4, PROTECT_THRESHOLD_MV);
   
-  // Start the 16-bit low counter
-  SCTIMER_StartTimer(SCT0, kSCTIMER_Counter_L);
+  // Start both 16-bit counters
+  SCTIMER_StartTimer(SCT0, kSCTIMER_Counter_L | kSCTIMER_Counter_H);
+}
+
+
+// The number of the match register used by an SCT event.
+// See: 16.6.24 SCT event control registers, MATCHSEL field.
+static uint32_t sct_event_match_reg(uint32_t event) {
+  return SCT0->EV[event].CTRL & SCT_EV_CTRL_MATCHSEL_MASK;
 }
 
 
+// Change the ADC sampling rate without stopping the timer.
+// Only the match *reload* register is written. The counter copies it to
+// the match register when it reaches its limit, so the current period
+// finishes normally.
+bool sct_set_sample_rate(uint32_t rate_hz) {
+
+  uint32_t counts;
+  uint32_t reg;
+
+  if ((rate_hz == 0U) || (rate_hz > SAMPLE_RATE_MAX_HZ)) {
+    return false;
+  }
+  counts = SCT_SAMPLE_CLOCK / (2U * rate_hz);
+  if ((counts == 0U) || (counts > 0x10000U)) {
+    return false; // Does not fit the 16 bit counter.
+  }
+
+  // Counter H uses the upper half of the match reload register. The
+  // lower half belongs to a counter L event (16 bit write, no RMW):
+  reg = sct_event_match_reg(adcTriggerEvent);
+  SCT0->MATCHREL_ACCESS16BIT[reg].MATCHRELH = (uint16_t)(counts - 1U);
+
+  sampleRateHz = SCT_SAMPLE_CLOCK / (2U * counts); // Actual rate.
+  internalRateHz = sampleRateHz;
+  if (adcDeadline != DEADLINE_INVALID) {
+    deadline_set_timing(adcDeadline, 1000000U / sampleRateHz,
+			500000U / sampleRateHz);
+  }
+  return true;
+}
+
+
+// Change the PWM frequency and duty cycle without stopping the timer.
+// The period and pulse events were created by SCTIMER_SetupPwm():
+// the pulse event is the one after the period event.
+bool sct_set_pwm(uint32_t frequency_hz, uint32_t duty_percent) {
+
+  uint32_t period;
+  uint32_t pulse;
+
+  if ((frequency_hz == 0U) || (duty_percent > 100U)) {
+    return false;
+  }
+  period = (PWM_CLOCK / frequency_hz) - 1U;
+  if ((period < 100U) || (period > 0xFFFDU)) {
+    return false; // Too coarse, or does not fit the 16 bit counter.
+  }
+
+  if (duty_percent == 100U) {
+    pulse = period + 2U; // Never matches: output stays active.
+  } else {
+    pulse = (period * duty_percent) / 100U;
+  }
+
+  // Counter L uses the lower half of the match reload registers. The
+  // upper halves belong to counter H events (ADC trigger, SPI ADC), so
+  // only the lower 16 bits are written:
+  SCT0->MATCHREL_ACCESS16BIT[sct_event_match_reg(pwmEvent)].MATCHRELL =
+    (uint16_t)period;
+  SCT0->MATCHREL_ACCESS16BIT[sct_event_match_reg(pwmEvent + 1U)].MATCHRELL =
+    (uint16_t)pulse;
+
+  pwmFrequencyHz = PWM_CLOCK / (period + 1U);
+  pwmDutyPercent = duty_percent;
+  return true;
+}
+
+
+// Change the channels of ADC Sequence A.
+// The analog function of each channel's pin is enabled in the switch matrix.
+// Channels whose pin is used by another function (board_pins.h) are refused.
+// See: Sec. 21.6.2 A/D Conversion Sequence A Control Register
+bool adc_set_channels(uint32_t mask) {
+
+  static const swm_select_fixed_pin_t adcPins[ADC_NUM_CHANNELS] = {
+    kSWM_ADC_CHN0, kSWM_ADC_CHN1, kSWM_ADC_CHN2,  kSWM_ADC_CHN3,
+    kSWM_ADC_CHN4, kSWM_ADC_CHN5, kSWM_ADC_CHN6,  kSWM_ADC_CHN7,
+    kSWM_ADC_CHN8, kSWM_ADC_CHN9, kSWM_ADC_CHN10, kSWM_ADC_CHN11,
+  };
+  uint32_t ch;
+  uint32_t seqCtrl;
+
+  if ((mask == 0U) || (mask >= (1U << ADC_NUM_CHANNELS))) {
+    return false;
+  }
+  for (ch = 0; ch < ADC_NUM_CHANNELS; ch++) {
+    if (((mask & (1U << ch)) != 0U) && !board_fixed_pin_free(adcPins[ch])) {
+      return false;
+    }
+  }
+
+  CLOCK_EnableClock(kCLOCK_Swm);
+  for (ch = 0; ch < ADC_NUM_CHANNELS; ch++) {
+    SWM_SetFixedPinSelect(SWM0, adcPins[ch], (mask & (1U << ch)) != 0U);
+  }
+  CLOCK_DisableClock(kCLOCK_Swm);
+
+  // The sequence is disabled only while the channel field is written.
+  // A trigger arriving in these few cycles is the only sample lost.
+  seqCtrl = ADC0->SEQ_CTRL[0];
+  ADC0->SEQ_CTRL[0] = seqCtrl & ~ADC_SEQ_CTRL_SEQ_ENA_MASK;
+  ADC0->SEQ_CTRL[0] = (seqCtrl & ~ADC_SEQ_CTRL_CHANNELS_MASK) | mask;
+
+  channelMask = mask;
+  return true;
+}
+
+
+
+
+
+// Change the source of the samples.
+// The SPI ADC uses counter H, so the on-chip ADC trigger event and
+// Sequence A are disabled while it runs.
+bool adc_set_source(uint32_t source) {
+
+  if (source == adcSource) {
+    return true;
+  }
+
+  if (source == ADC_SOURCE_SPI) {
+    ADC_EnableConvSeqA(ADC0, false);
+    SCT0->EV[adcTriggerEvent].STATE = 0;   // Not in any state: disabled.
+    if (spi_adc_start(SPI_ADC_RATE_HZ) != kStatus_Success) {
+      SCT0->EV[adcTriggerEvent].STATE = 1U;
+      ADC_EnableConvSeqA(ADC0, true);
+      return false;
+    }
+    deadline_set_timing(adcDeadline, 0, 0);  // No ADC interrupts now.
+    sampleRateHz = spi_adc_rate();
+    deadline_set_timing(spiDeadline,
+			(SPI_ADC_BLOCK_LEN * 1000000U) / sampleRateHz,
+			(SPI_ADC_BLOCK_LEN * 500000U) / sampleRateHz);
+  } else if (source == ADC_SOURCE_INTERNAL) {
+    spi_adc_stop();
+    deadline_set_timing(spiDeadline, 0, 0);
+    SCT0->EV[adcTriggerEvent].STATE = 1U;    // Enabled in state 0 again.
+    ADC_EnableConvSeqA(ADC0, true);
+    sct_set_sample_rate(internalRateHz);     // Also the ADC deadline.
+  } else {
+    return false;
+  }
+
+  adcSource = source;
+  return true;
+}
+
+
+// Give the blocks of the SPI ADC to the same telemetry as the ADC ISR
+// (called from the main loop). Results are scaled to 12 bits.
+// A block is filled every 640 us at 100 kHz: a RAW line for each block
+// would hold the main loop in CONSOLE_PRINTF. So in RAW mode only the
+// first result of a block is printed, and only every SPI_ADC_RAW_PRINT_MS.
+void spi_block_process(void) {
+
+  static uint32_t lastRawPrintMs;
+  const spi_adc_format_t *format = spi_adc_format();
+  const uint16_t *block;
+  uint32_t i;
+  uint32_t result;
+
+  while ((block = spi_adc_get_block()) != NULL) {
+    deadline_begin(spiDeadline);
+    for (i = 0; i < SPI_ADC_BLOCK_LEN; i++) {
+      result = spi_adc_decode(format, block[i]);
+      result = (format->dataBits > 12U) ? (result >> (format->dataBits - 12U)) :
+					  (result << (12U - format->dataBits));
+      if (telemetryMode == TELEMETRY_BINARY) {
+	telemetry_put(SPI_ADC_CHANNEL, result);
+      } else if (telemetryMode == TELEMETRY_STATS) {
+	sig_stats_add(SPI_ADC_CHANNEL, (uint16_t)result);
+      } else if (telemetryMode == TELEMETRY_SPECTRUM) {
+	spectrum_put(result);
+      } else if ((telemetryMode == TELEMETRY_RAW) && (i == 0U) &&
+		 ((timebase_ms() - lastRawPrintMs) >= SPI_ADC_RAW_PRINT_MS)) {
+	lastRawPrintMs = timebase_ms();
+	CONSOLE_PRINTF("SPI result = %d    \r", result);
+      }
+    }
+    spi_adc_release_block();
+    deadline_end(spiDeadline);
+  }
+}
+
 
 
 
@@ -304,7 +1075,14 @@ status_t uart_init(void) {
 			   USART_BAUDRATE,
 			   kSerialPort_Uart,
 			   uart_clock_freq);
-  return result;
+  if (result != kStatus_Success) {
+    return result;
+  }
+
+  // Replace the integer divider set by DbgConsole_Init with one that also
+  // uses the fractional rate generator: 115200 baud from 30 MHz has
+  // about 1.7% error with BRG alone (117188 baud).
+  return uart_dma_set_baud(uart_clock_freq, USART_BAUDRATE, &baudConfig);
 
 }
 
@@ -1,77 +1,236 @@
+// Pin configuration calculated at compile time from board_pins.h.
+//
+// Each pass below defines the BOARD_* macros, expands BOARD_PINS and
+// #undefs them again. The checks are done by the compiler:
+//  - Every pin and every function gets an enumerator. If a pin or a
+//    function is in the list twice, the enumerator is declared twice, and
+//    the error names the pin (e.g. 'boardPinUsed_PIO0_15').
+//  - The pin of a fixed function must be the one in swmFixedPins.
+//  - A movable function must not be in SWM_FIXED_PINS.
+// What is left for InitPins() are the register values, in flash.
 
 #include "fsl_common.h"
 #include "fsl_iocon.h"
 #include "fsl_swm.h"
 #include "pin_mux.h"
+#include "board_pins.h"
+
+#define SWM_PINASSIGN_WORDS 12U   // PINASSIGN0..11, one byte per function.
+#define PIO0_LAST_PIN 28U
+
+// IOCON of analog pins: no pull-up or pull-down, no hysteresis.
+#define IOCON_PIO_ANALOG (IOCON_PIO_MODE_INACT | IOCON_PIO_HYS_DI |	\
+			  IOCON_PIO_INV_DI | IOCON_PIO_OD_DI |		\
+			  IOCON_PIO_SMODE_BYPASS | IOCON_PIO_CLKDIV0)
+
+// The pins of the fixed-pin functions.
+// See: User Manual, Switch matrix chapter, PINENABLE0 register.
+#define SWM_FIXED_PINS				\
+  SWM_FIXED(ACMP_INPUT1, 0)			\
+  SWM_FIXED(ACMP_INPUT2, 1)			\
+  SWM_FIXED(ACMP_INPUT3, 14)			\
+  SWM_FIXED(ACMP_INPUT4, 23)			\
+  SWM_FIXED(SWCLK,       3)			\
+  SWM_FIXED(SWDIO,       2)			\
+  SWM_FIXED(XTALIN,      8)			\
+  SWM_FIXED(XTALOUT,     9)			\
+  SWM_FIXED(RESETN,      5)			\
+  SWM_FIXED(CLKIN,       1)			\
+  SWM_FIXED(VDDCMP,      6)			\
+  SWM_FIXED(I2C0_SDA,    11)			\
+  SWM_FIXED(I2C0_SCL,    10)			\
+  SWM_FIXED(ADC_CHN0,    7)			\
+  SWM_FIXED(ADC_CHN1,    6)			\
+  SWM_FIXED(ADC_CHN2,    14)			\
+  SWM_FIXED(ADC_CHN3,    23)			\
+  SWM_FIXED(ADC_CHN4,    22)			\
+  SWM_FIXED(ADC_CHN5,    21)			\
+  SWM_FIXED(ADC_CHN6,    20)			\
+  SWM_FIXED(ADC_CHN7,    19)			\
+  SWM_FIXED(ADC_CHN8,    18)			\
+  SWM_FIXED(ADC_CHN9,    17)			\
+  SWM_FIXED(ADC_CHN10,   13)			\
+  SWM_FIXED(ADC_CHN11,   4)
+
+#define SWM_FIXED(func, n) swmFixedPin_##func = (n),
+enum swm_fixed_pins { SWM_FIXED_PINS };
+#undef SWM_FIXED
+
+
+/////////////// Checks /////////////////////////////////
+
+// Pins and functions used; declared twice if used twice:
+#define BOARD_PIN(n, func, iocon)					\
+  boardPinUsed_PIO0_##n, boardPinDigital_PIO0_##n, boardFuncUsed_##func,
+#define BOARD_ALSO(n, func)         boardFuncUsed_##func,
+#define BOARD_ANALOG(n, func)       boardPinUsed_PIO0_##n, boardFuncUsed_##func,
+#define BOARD_FIXED(n, func, iocon) boardPinUsed_PIO0_##n, boardFuncUsed_##func,
+#define BOARD_GPIO(n, iocon)						\
+  boardPinUsed_PIO0_##n, boardPinDigital_PIO0_##n,
+enum board_pins_used { BOARD_PINS };
+#undef BOARD_PIN
+#undef BOARD_ALSO
+#undef BOARD_ANALOG
+#undef BOARD_FIXED
+#undef BOARD_GPIO
+
+// The kSWM_ names of the fixed functions are bit masks, and the small
+// ones (kSWM_ACMP_INPUT1 == 1) are valid PINASSIGN byte numbers too. So a
+// movable function also gets a swmFixedPin_ enumerator: it is declared
+// twice if the function is a fixed one (e.g. 'swmFixedPin_ACMP_INPUT1').
+#define BOARD_PIN(n, func, iocon)   swmFixedPin_##func,
+#define BOARD_ALSO(n, func)         swmFixedPin_##func,
+#define BOARD_ANALOG(n, func)
+#define BOARD_FIXED(n, func, iocon)
+#define BOARD_GPIO(n, iocon)
+enum board_movable_funcs { BOARD_PINS boardMovableFuncs };
+#undef BOARD_PIN
+#undef BOARD_ALSO
+#undef BOARD_ANALOG
+#undef BOARD_FIXED
+#undef BOARD_GPIO
+
+#define CHECK_PIN(n)							\
+  _Static_assert((n) <= PIO0_LAST_PIN, "PIO0_" #n " does not exist");
+#define CHECK_MOVABLE(func)						\
+  _Static_assert((uint32_t)kSWM_##func < (SWM_PINASSIGN_WORDS * 4U),	\
+		 #func " is not a movable function");
+#define CHECK_FIXED(n, func)						\
+  _Static_assert((n) == swmFixedPin_##func, #func " is not on PIO0_" #n);
+
+#define BOARD_PIN(n, func, iocon)   CHECK_PIN(n) CHECK_MOVABLE(func)
+// An input may share the pin of a BOARD_PIN, but not of an analog pin:
+#define BOARD_ALSO(n, func)						\
+  CHECK_MOVABLE(func)							\
+  _Static_assert(boardPinDigital_PIO0_##n >= 0, "");
+#define BOARD_ANALOG(n, func)       CHECK_PIN(n) CHECK_FIXED(n, func)
+#define BOARD_FIXED(n, func, iocon) CHECK_PIN(n) CHECK_FIXED(n, func)
+#define BOARD_GPIO(n, iocon)        CHECK_PIN(n)
+BOARD_PINS
+#undef BOARD_PIN
+#undef BOARD_ALSO
+#undef BOARD_ANALOG
+#undef BOARD_FIXED
+#undef BOARD_GPIO
+
+
+/////////////// Register values /////////////////////////////////
+
+typedef struct {
+  uint8_t index;    // IOCON_INDEX_PIO0_n
+  uint32_t value;
+} board_iocon_t;
+
+// IOCON value of every pin in the list:
+#define BOARD_PIN(n, func, iocon)   { IOCON_INDEX_PIO0_##n, (iocon) },
+#define BOARD_ALSO(n, func)
+#define BOARD_ANALOG(n, func)       { IOCON_INDEX_PIO0_##n, IOCON_PIO_ANALOG },
+#define BOARD_FIXED(n, func, iocon) { IOCON_INDEX_PIO0_##n, (iocon) },
+#define BOARD_GPIO(n, iocon)        { IOCON_INDEX_PIO0_##n, (iocon) },
+static const board_iocon_t ioconTable[] = { BOARD_PINS };
+#undef BOARD_PIN
+#undef BOARD_ALSO
+#undef BOARD_ANALOG
+#undef BOARD_FIXED
+#undef BOARD_GPIO
+
+#define IOCON_TABLE_LEN (sizeof(ioconTable) / sizeof(ioconTable[0]))
+
+// PINASSIGN registers: byte kSWM_func is the pin of the movable function,
+// 0xFF if it is not used. (The Cortex-M0+ is little-endian: byte 0 is
+// bits 7:0 of PINASSIGN0.)
+#define BOARD_PIN(n, func, iocon)   [kSWM_##func] = (n),
+#define BOARD_ALSO(n, func)         [kSWM_##func] = (n),
+#define BOARD_ANALOG(n, func)
+#define BOARD_FIXED(n, func, iocon)
+#define BOARD_GPIO(n, iocon)
+static const union {
+  uint8_t byte[SWM_PINASSIGN_WORDS * 4U];
+  uint32_t word[SWM_PINASSIGN_WORDS];
+} pinAssign = {
+  .byte = { [0 ... (SWM_PINASSIGN_WORDS * 4U - 1U)] = 0xFFU, BOARD_PINS }
+};
+#undef BOARD_PIN
+#undef BOARD_ALSO
+#undef BOARD_ANALOG
+#undef BOARD_FIXED
+#undef BOARD_GPIO
+
+// Bit masks: pins in the list, pins used as digital, fixed functions on.
+#define BOARD_PIN(n, func, iocon)   | (1 << (n))
+#define BOARD_ALSO(n, func)
+#define BOARD_ANALOG(n, func)       | (1 << (n))
+#define BOARD_FIXED(n, func, iocon) | (1 << (n))
+#define BOARD_GPIO(n, iocon)        | (1 << (n))
+enum { boardUsedPins = 0 BOARD_PINS };
+#undef BOARD_ANALOG
+#undef BOARD_FIXED
+#define BOARD_ANALOG(n, func)
+#define BOARD_FIXED(n, func, iocon)
+enum { boardDigitalPins = 0 BOARD_PINS };
+#undef BOARD_PIN
+#undef BOARD_ANALOG
+#undef BOARD_FIXED
+#undef BOARD_GPIO
+#define BOARD_PIN(n, func, iocon)
+#define BOARD_ANALOG(n, func)       | kSWM_##func
+#define BOARD_FIXED(n, func, iocon) | kSWM_##func
+#define BOARD_GPIO(n, iocon)
+enum { boardFixedOn = 0 BOARD_PINS };
+#undef BOARD_PIN
+#undef BOARD_ALSO
+#undef BOARD_ANALOG
+#undef BOARD_FIXED
+#undef BOARD_GPIO
+
+// Fixed functions whose pin is used as digital (e.g. SWD, on by default):
+#define SWM_FIXED(func, n)						\
+  | ((((uint32_t)boardDigitalPins >> (n)) & 1U) ? (uint32_t)kSWM_##func : 0U)
+static const uint32_t boardFixedOff = 0U SWM_FIXED_PINS;
+#undef SWM_FIXED
+
 
 void InitPins(void) {
 
-  uint32_t IOCON_PIO_config;// This is the struct for keeping the GPIO pin conf
-                   // See: User Manual Section 8.4.1 Pin Configuration & Fig.10
-  
-  
+  uint32_t i;
+
   CLOCK_EnableClock(kCLOCK_Iocon);  // Enable IOCON clock
-  
   CLOCK_EnableClock(kCLOCK_Swm);  // Enable SWM clock
 
+  // See: User Manual Section 8.4.1 Pin Configuration & Fig.10
+  for (i = 0; i < IOCON_TABLE_LEN; i++) {
+    IOCON_PinMuxSet(IOCON, ioconTable[i].index, ioconTable[i].value);
+  }
+
+  // Movable functions; the registers not used keep their reset value:
+  for (i = 0; i < SWM_PINASSIGN_WORDS; i++) {
+    if (pinAssign.word[i] != 0xFFFFFFFFU) {
+      SWM0->PINASSIGN_DATA[i] = pinAssign.word[i];
+    }
+  }
 
+  // Fixed functions: a 0 bit enables the function.
+  SWM0->PINENABLE0 = (SWM0->PINENABLE0 & ~(uint32_t)boardFixedOn) |
+		     boardFixedOff;
 
-    /////////////// USART RX and TX pins Configuration /////////////////////////////////
-
-  // Configure PIO_0, (Alakart label: P0) as USART RXD
-  // IC package physical pin is: 24
-  // GPIO pin name: PIO0_0
-  // Peripheral: USART, signal: RXD,
-  
-  // First configure the GPIO pin characteristics:
-  IOCON_PIO_config = (IOCON_PIO_MODE_PULLUP |  // Select pull-up function
-		      IOCON_PIO_HYS_DI |       // Disable hysteresis
-		      IOCON_PIO_INV_DI |       // Do not invert input
-		      IOCON_PIO_OD_DI |        // Disable open-drain function
-		      IOCON_PIO_SMODE_BYPASS | // Bypass the input filter
-		      IOCON_PIO_CLKDIV0);      // IOCONCLKDIV = 0
-
-  // PIO0 PIN0 (pin no 24) is configured as USART0, RXD.
-  IOCON_PinMuxSet(IOCON, IOCON_INDEX_PIO0_0, IOCON_PIO_config);
-  
-  // Connect USART0_RXD to P0_0
-  SWM_SetMovablePinSelect(SWM0, kSWM_USART0_RXD, kSWM_PortPin_P0_0);
-
-  
-
-  IOCON_PIO_config = (IOCON_PIO_MODE_PULLUP |  // Select pull-up function
-		      IOCON_PIO_HYS_DI |       // Disable hysteresis
-		      IOCON_PIO_INV_DI |       // Do not invert input
-		      IOCON_PIO_OD_DI |        // Disable open-drain function
-		      IOCON_PIO_SMODE_BYPASS | // Bypass the input filter
-		      IOCON_PIO_CLKDIV0);
-  // PIO0_4 (pin no 4) is configured with these properties.
-  IOCON_PinMuxSet(IOCON, IOCON_INDEX_PIO0_4, IOCON_PIO_config);
-
-  // Connect USART0_TXD to PIO0_4 
-  SWM_SetMovablePinSelect(SWM0, kSWM_USART0_TXD, kSWM_PortPin_P0_4);
-  
-  /////////////// ADC CH1 Configuration /////////////////////////////////
-
-  // Configure PIO_6, (Alakart label: P6)  as : ADC CH 1
-  // IC package physical pin is: 23,
-  // GPIO pin name: PIO0_6
-  // Peripheral: ADC, signal: CHN1
-  
-  IOCON_PIO_config = (//Deactivate pull-up
-		  IOCON_PIO_HYS_DI |      // Disable hysteresis
-		  IOCON_PIO_INV_DI |      // Do not invert if input
-		  IOCON_PIO_OD_DI |       // Disable open-drain
-		  IOCON_PIO_SMODE_BYPASS |// Bypass input filter
-		  IOCON_PIO_CLKDIV0);     // IOCONCLKDIV0
-  // Configure PIO0_6 (pin no 23)  with these properties.
-  IOCON_PinMuxSet(IOCON, IOCON_INDEX_PIO0_6, IOCON_PIO_config);
-  
-  // Enable analog functionality on PIO0_6:
-  SWM_SetFixedPinSelect(SWM0, kSWM_ADC_CHN1, true);
-
-
-  
   // Disable SWM clock since configuration is complete
   CLOCK_DisableClock(kCLOCK_Swm);
 }
+
+
+bool board_fixed_pin_free(swm_select_fixed_pin_t func) {
+
+  uint32_t pin;
+
+  switch (func) {
+#define SWM_FIXED(f, n) case kSWM_##f: pin = (n); break;
+    SWM_FIXED_PINS
+#undef SWM_FIXED
+  default:
+    return false;
+  }
+
+  // Free, or used by this function itself:
+  return ((((uint32_t)boardUsedPins >> pin) & 1U) == 0U) ||
+	 (((uint32_t)boardFixedOn & (uint32_t)func) != 0U);
+}
@@ -6,14 +6,34 @@
 #ifndef _PIN_MUX_H_
 #define _PIN_MUX_H_
 
+#include <stdbool.h>
+#include "fsl_swm.h"
+
+// Write the pin configuration of board_pins.h.
 void InitPins(void);
 
-#define IOCON_PIO_CLKDIV0 0x00u       //IOCONCLKDIV0 
-#define IOCON_PIO_HYS_EN 0x20u        //Enable hysteresis 
+// true if the pin of a fixed function is not used by another function in
+// board_pins.h, so that the function can be switched on at run time.
+bool board_fixed_pin_free(swm_select_fixed_pin_t func);
+
+// IOCON register bits. See: User Manual Section 8.4.1 Pin Configuration
+#define IOCON_PIO_CLKDIV0 0x00u       //IOCONCLKDIV0
+#define IOCON_PIO_CLKDIV(n) ((uint32_t)(n) << 13) // IOCONCLKDIVn for filter
+#define IOCON_PIO_HYS_EN 0x20u        //Enable hysteresis
 #define IOCON_PIO_HYS_DI 0x00u        // Disable hysteresis
-#define IOCON_PIO_INV_DI 0x00u        //Input not invert 
-#define IOCON_PIO_MODE_PULLUP 0x10u   //Selects pull-up function 
-#define IOCON_PIO_OD_DI 0x00u         //Disables Open-drain function 
-#define IOCON_PIO_SMODE_BYPASS 0x00u  //Bypass input filter 
+#define IOCON_PIO_INV_EN 0x40u        // Invert input
+#define IOCON_PIO_INV_DI 0x00u        //Input not invert
+#define IOCON_PIO_MODE_INACT 0x00u    // No pull-up or pull-down
+#define IOCON_PIO_MODE_PULLDOWN 0x08u // Selects pull-down function
+#define IOCON_PIO_MODE_PULLUP 0x10u   //Selects pull-up function
+#define IOCON_PIO_MODE_REPEATER 0x18u // Selects repeater mode
+#define IOCON_PIO_OD_EN 0x400u        // Enables Open-drain function
+#define IOCON_PIO_OD_DI 0x00u         //Disables Open-drain function
+#define IOCON_PIO_SMODE_BYPASS 0x00u  //Bypass input filter
+#define IOCON_PIO_SMODE_1CLK 0x800u   // Filter: pulses shorter than 1 clock
+#define IOCON_PIO_SMODE_2CLK 0x1000u  // Filter: ... 2 clocks
+#define IOCON_PIO_SMODE_3CLK 0x1800u  // Filter: ... 3 clocks
+#define IOCON_PIO_I2CMODE_STD 0x000u  // PIO0_10/11: Standard/Fast-mode I2C
+#define IOCON_PIO_I2CMODE_FASTPLUS 0x200u // PIO0_10/11: Fast-mode Plus I2C
 
-#endif // _PIN_MUX_H_ 
+#endif // _PIN_MUX_H_
@@ -0,0 +1,132 @@
+// Protection with the analog comparator. See protect.h.
+
+#include "fsl_device_registers.h"
+#include "fsl_clock.h"
+#include "fsl_power.h"
+#include "fsl_acomp.h"
+#include "protect.h"
+#include "timebase.h"
+
+#define LADDER_STEPS 31U        // The ladder has 32 values: 0 .. VDD.
+#define ACMP_INPUT_LADDER 0U    // See: 22.6.1 Comparator control register,
+#define ACMP_INPUT_I2 2U        //      VP_SEL and VM_SEL.
+
+static uint32_t ladderValue;
+static uint32_t tripEvent;      // SCT event: input 1 high.
+
+// Written by CMP_IRQHandler, and by the main loop with interrupts disabled:
+static protect_fsm_t fsm;
+
+
+void protect_init(sctimer_out_t output, uint32_t thresholdMv) {
+
+  acomp_config_t acompConfig;
+
+  // Comparator: ACMP_I2 on the + input, the voltage ladder on the - input.
+  // The output is high while the sensed voltage is above the threshold.
+  POWER_DisablePD(kPDRUNCFG_PD_ACMP);
+  ACOMP_GetDefaultConfig(&acompConfig);
+  acompConfig.enableSyncToBusClk = false;  // Faster; the SCT synchronizes.
+  acompConfig.hysteresisSelection = kACOMP_Hysteresis20MVSelection;
+  ACOMP_Init(ACOMP, &acompConfig);
+  ACOMP_SetInputChannel(ACOMP, ACMP_INPUT_I2, ACMP_INPUT_LADDER);
+  protect_set_threshold_mv(thresholdMv);
+
+  // The comparator output goes to P0_15, and SCT input 1 reads the same
+  // pin. Both are set by InitPins() (see board_pins.h).
+
+  // While input 1 is high: clear the PWM output and halt counter L.
+  // A level (not edge) event, so that a restart while the voltage is
+  // still high trips again at once.
+  SCTIMER_CreateAndScheduleEvent(SCT0, kSCTIMER_InputHighEvent, 0,
+				 kSCTIMER_Input_1, kSCTIMER_Counter_L, &tripEvent);
+  SCTIMER_SetupOutputClearAction(SCT0, output, tripEvent);
+  SCTIMER_SetupCounterHaltAction(SCT0, kSCTIMER_Counter_L, tripEvent);
+
+  // If the PWM sets the output in the same clock as the trip clears it,
+  // clear wins. See: 16.6.16 SCT conflict resolution register.
+  SCT0->RES = (SCT0->RES & ~(3U << (2U * output))) | (2U << (2U * output));
+
+  protect_fsm_init(&fsm);
+  ACOMP_ClearInterruptsStatusFlags(ACOMP);
+  ACOMP_EnableInterrupts(ACOMP, kACOMP_InterruptsBothEdgesEnable);
+  NVIC_EnableIRQ(CMP_IRQn);
+}
+
+
+bool protect_set_threshold_mv(uint32_t thresholdMv) {
+
+  acomp_ladder_config_t ladderConfig;
+  uint32_t value;
+
+  if (thresholdMv > PROTECT_VDD_MV) {
+    return false;
+  }
+  value = ((thresholdMv * LADDER_STEPS) + (PROTECT_VDD_MV / 2U)) / PROTECT_VDD_MV;
+  if (value == 0U) {
+    return false;   // 0 V: would always trip.
+  }
+
+  ladderConfig.ladderValue = (uint8_t)value;
+  ladderConfig.referenceVoltage = kACOMP_LadderRefVoltagePinVDD;
+  ACOMP_SetLadderConfig(ACOMP, &ladderConfig);
+  ladderValue = value;
+  return true;
+}
+
+
+uint32_t protect_get_threshold_mv(void) {
+  return (ladderValue * PROTECT_VDD_MV) / LADDER_STEPS;
+}
+
+
+// Clear the halt of counter L: the PWM continues with the next period.
+static void pwm_restart(void) {
+  SCTIMER_StartTimer(SCT0, kSCTIMER_Counter_L);
+}
+
+
+void protect_poll(void) {
+
+  uint32_t primask = DisableGlobalIRQ();
+
+  if (protect_fsm_poll(&fsm, timebase_ms())) {
+    pwm_restart();
+  }
+  EnableGlobalIRQ(primask);
+}
+
+
+bool protect_rearm(void) {
+
+  uint32_t primask;
+
+  if (ACOMP_GetOutputStatusFlags(ACOMP)) {
+    return false;   // Still above the threshold.
+  }
+  primask = DisableGlobalIRQ();
+  if (protect_fsm_rearm(&fsm)) {
+    pwm_restart();
+  }
+  EnableGlobalIRQ(primask);
+  return true;
+}
+
+
+void protect_get_stats(protect_stats_t *copy) {
+
+  uint32_t primask = DisableGlobalIRQ();
+  *copy = fsm.stats;
+  EnableGlobalIRQ(primask);
+}
+
+
+// Comparator output changed. The PWM was already halted by the SCT;
+// here the trip is only counted and the restart is decided.
+// It was declared in the file startup_LPC824.S.
+void CMP_IRQHandler(void) {
+
+  ACOMP_ClearInterruptsStatusFlags(ACOMP);
+  protect_fsm_edge(&fsm, ACOMP_GetOutputStatusFlags(ACOMP) != 0U,
+		   timebase_ms());
+}
@@ -0,0 +1,44 @@
+// Overcurrent / overvoltage protection with the analog comparator.
+//
+// The sensed voltage (ACMP_I2, PIO0_1) is compared with a threshold from
+// the comparator's internal voltage ladder. The comparator output is
+// connected through the switch matrix to P0_15 (see board_pins.h), and SCT
+// input 1 reads the same pin. While the input is high, an SCT event clears
+// the PWM output and halts counter L. This is done by the hardware within a
+// few clock cycles; no ADC sample and no ISR is needed.
+//
+// The comparator interrupt (CMP_IRQHandler) only counts the trips and
+// decides if the PWM may be started again (protect_fsm.h):
+//  - When the voltage is below the threshold again, the PWM is restarted
+//    by protect_poll() after PROTECT_HOLDOFF_MS.
+//  - After PROTECT_MAX_RETRIES trips within PROTECT_RETRY_WINDOW_MS, the
+//    PWM stays off (latched) until protect_rearm() is called.
+// See: User Manual Chapter 22, Analog comparator.
+
+#ifndef _PROTECT_H_
+#define _PROTECT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fsl_sctimer.h"
+#include "protect_fsm.h"
+
+#define PROTECT_VDD_MV 3300U      // Reference of the voltage ladder.
+
+// Set up the comparator and the trip event for the PWM on 'output'.
+// Must be called after SCTIMER_SetupPwm() and before the SCT is started.
+void protect_init(sctimer_out_t output, uint32_t thresholdMv);
+
+// Threshold in mV, rounded to the nearest ladder step (VDD / 31).
+bool protect_set_threshold_mv(uint32_t thresholdMv);
+uint32_t protect_get_threshold_mv(void);
+
+// Call from the main loop: restarts the PWM when the hold off time is over.
+void protect_poll(void);
+
+// Restart the PWM, also when latched. Fails if the voltage is still high.
+bool protect_rearm(void);
+
+void protect_get_stats(protect_stats_t *stats);
+
+#endif // _PROTECT_H_
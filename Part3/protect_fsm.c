@@ -0,0 +1,63 @@
+// Trip, restart and latch decisions of the protection. See protect_fsm.h.
+
+#include "protect_fsm.h"
+
+
+void protect_fsm_init(protect_fsm_t *fsm) {
+
+  fsm->stats.trips = 0;
+  fsm->stats.rearms = 0;
+  fsm->stats.lastTripMs = 0;
+  fsm->stats.state = kProtect_Running;
+  fsm->rearmAtMs = 0;
+  fsm->windowStartMs = 0;
+  fsm->retries = 0;
+}
+
+
+void protect_fsm_edge(protect_fsm_t *fsm, bool above, uint32_t nowMs) {
+
+  if (above) {
+    // Rising: the SCT has already halted the PWM.
+    fsm->stats.trips++;
+    fsm->stats.lastTripMs = nowMs;
+    if ((nowMs - fsm->windowStartMs) > PROTECT_RETRY_WINDOW_MS) {
+      fsm->windowStartMs = nowMs;
+      fsm->retries = 0;
+    }
+    if ((fsm->stats.state == kProtect_Latched) ||
+	(++fsm->retries >= PROTECT_MAX_RETRIES)) {
+      fsm->stats.state = kProtect_Latched;
+    } else {
+      fsm->stats.state = kProtect_Tripped;
+    }
+  } else if (fsm->stats.state == kProtect_Tripped) {
+    // Falling: below the threshold again. Restart after the hold off time.
+    fsm->rearmAtMs = nowMs + PROTECT_HOLDOFF_MS;
+    fsm->stats.state = kProtect_Holdoff;
+  }
+}
+
+
+bool protect_fsm_poll(protect_fsm_t *fsm, uint32_t nowMs) {
+
+  if ((fsm->stats.state != kProtect_Holdoff) ||
+      ((int32_t)(nowMs - fsm->rearmAtMs) < 0)) {
+    return false;
+  }
+  fsm->stats.rearms++;
+  fsm->stats.state = kProtect_Running;
+  return true;
+}
+
+
+bool protect_fsm_rearm(protect_fsm_t *fsm) {
+
+  fsm->retries = 0;
+  if (fsm->stats.state == kProtect_Running) {
+    return false;
+  }
+  fsm->stats.rearms++;
+  fsm->stats.state = kProtect_Running;
+  return true;
+}
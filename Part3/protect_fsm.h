@@ -0,0 +1,52 @@
+// Trip, restart and latch decisions of the protection (used by protect.h).
+//
+// This part does not access the hardware, so it can also be compiled on a
+// PC and tested. protect.c calls it from the comparator interrupt and from
+// the main loop (with the interrupts disabled), and starts the PWM when
+// it says so.
+
+#ifndef _PROTECT_FSM_H_
+#define _PROTECT_FSM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define PROTECT_HOLDOFF_MS 100U
+#define PROTECT_MAX_RETRIES 3U
+#define PROTECT_RETRY_WINDOW_MS 5000U
+
+typedef enum {
+  kProtect_Running = 0,   // PWM on.
+  kProtect_Tripped,       // PWM halted, voltage still above threshold.
+  kProtect_Holdoff,       // Voltage below threshold, restart pending.
+  kProtect_Latched,       // Too many trips: PWM off until protect_rearm().
+} protect_state_t;
+
+typedef struct {
+  uint32_t trips;
+  uint32_t rearms;        // Automatic and manual restarts.
+  uint32_t lastTripMs;    // Time of the last trip (ms since start).
+  protect_state_t state;
+} protect_stats_t;
+
+typedef struct {
+  protect_stats_t stats;
+  uint32_t rearmAtMs;
+  uint32_t windowStartMs; // Start of the retry window.
+  uint32_t retries;       // Trips in this window.
+} protect_fsm_t;
+
+void protect_fsm_init(protect_fsm_t *fsm);
+
+// The comparator output changed: 'above' is true if the voltage is above
+// the threshold now.
+void protect_fsm_edge(protect_fsm_t *fsm, bool above, uint32_t nowMs);
+
+// true if the hold off time is over: the PWM must be restarted now.
+bool protect_fsm_poll(protect_fsm_t *fsm, uint32_t nowMs);
+
+// Manual restart, also when latched. Call only while the voltage is below
+// the threshold. true if the PWM must be restarted.
+bool protect_fsm_rearm(protect_fsm_t *fsm);
+
+#endif // _PROTECT_FSM_H_
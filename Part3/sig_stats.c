@@ -0,0 +1,155 @@
+// Windowed signal statistics. See sig_stats.h.
+
+#include "fsl_common.h"
+#include "sig_stats.h"
+
+// Window being accumulated by the ISR, and the last complete window.
+static sig_stats_acc_t running[SIG_STATS_CHANNELS];
+static sig_stats_acc_t closed[SIG_STATS_CHANNELS];
+static volatile uint32_t closedMask;   // Bit n: closed[n] not read yet.
+static volatile uint32_t overwritten;
+static volatile uint32_t windowLength = SIG_STATS_WINDOW_DEFAULT;
+
+
+static void acc_start(sig_stats_acc_t *acc, uint16_t sample) {
+  acc->count = 1;
+  acc->offset = sample;
+  acc->min = sample;
+  acc->max = sample;
+  acc->sum = 0;
+  acc->sumSq = 0;
+}
+
+// Integer square root (rounded down).
+static uint32_t isqrt64(uint64_t x) {
+  uint64_t result = 0;
+  uint64_t bit = (uint64_t)1 << 62;
+
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit != 0U) {
+    if (x >= result + bit) {
+      x -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)result;
+}
+
+
+void sig_stats_init(uint32_t window) {
+  uint32_t ch;
+
+  for (ch = 0; ch < SIG_STATS_CHANNELS; ch++) {
+    running[ch].count = 0;
+  }
+  closedMask = 0;
+  overwritten = 0;
+  sig_stats_set_window(window);
+}
+
+
+bool sig_stats_set_window(uint32_t window) {
+  if ((window < 2U) || (window > SIG_STATS_WINDOW_MAX)) {
+    return false;
+  }
+  windowLength = window;
+  return true;
+}
+
+
+uint32_t sig_stats_get_window(void) {
+  return windowLength;
+}
+
+
+void sig_stats_add(uint32_t channel, uint16_t sample) {
+
+  sig_stats_acc_t *acc = &running[channel];
+  int32_t d;
+
+  if (acc->count == 0U) {
+    acc_start(acc, sample);
+  } else {
+    d = (int32_t)sample - (int32_t)acc->offset;
+    acc->sum += d;
+    acc->sumSq += (uint32_t)(d * d);  // |d| < 4096, the square fits 32 bits.
+    if (sample < acc->min) {
+      acc->min = sample;
+    }
+    if (sample > acc->max) {
+      acc->max = sample;
+    }
+    acc->count++;
+  }
+
+  if (acc->count >= windowLength) {
+    if (closedMask & (1U << channel)) {
+      overwritten++;   // The previous window was not read by the main loop.
+    }
+    closed[channel] = *acc;
+    closedMask |= (1U << channel);
+    acc->count = 0;    // The next sample starts a new window.
+  }
+}
+
+
+bool sig_stats_read(uint32_t channel, sig_stats_result_t *result) {
+
+  sig_stats_acc_t acc;
+  uint32_t primask;
+
+  if ((closedMask & (1U << channel)) == 0U) {
+    return false;
+  }
+
+  // Copy the sums with interrupts off, so that the ISR can not change them
+  // in the middle. The calculation is done with interrupts on.
+  primask = DisableGlobalIRQ();
+  acc = closed[channel];
+  closedMask &= ~(1U << channel);
+  EnableGlobalIRQ(primask);
+
+  sig_stats_compute(&acc, result);
+  return true;
+}
+
+
+void sig_stats_compute(const sig_stats_acc_t *acc, sig_stats_result_t *result) {
+
+  uint32_t n = acc->count;
+  int64_t sum = acc->sum;
+  uint64_t sumSqTotal;
+  int32_t meanOffset;
+  uint64_t offset = acc->offset;
+
+  result->count = n;
+  result->min = acc->min;
+  result->max = acc->max;
+  result->peakToPeak = acc->max - acc->min;
+
+  // mean = offset + sum/n, rounded to the nearest count.
+  if (sum >= 0) {
+    meanOffset = (int32_t)((sum + n / 2U) / n);
+  } else {
+    meanOffset = -(int32_t)((-sum + n / 2U) / n);
+  }
+  result->mean = (uint16_t)((int32_t)acc->offset + meanOffset);
+
+  // variance = (sumSq - sum^2/n) / n. Shifting the data does not change it.
+  result->variance = (uint32_t)((acc->sumSq - (uint64_t)(sum * sum) / n) / n);
+
+  // RMS needs the sum of the squares of the samples themselves:
+  //  sum(x^2) = sumSq + 2*offset*sum + n*offset^2
+  sumSqTotal = acc->sumSq + (uint64_t)(2 * (int64_t)offset * sum) + n * offset * offset;
+  result->rms = (uint16_t)isqrt64((sumSqTotal + n / 2U) / n);
+}
+
+
+uint32_t sig_stats_overwritten(void) {
+  return overwritten;
+}
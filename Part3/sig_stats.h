@@ -0,0 +1,66 @@
+// Windowed signal statistics for ADC channels.
+//
+// Instead of sending every sample, min, max, mean, RMS, variance and
+// peak-to-peak are calculated over a window of samples and only these
+// results are sent.
+//
+// sig_stats_add() is called from the ADC ISR for each sample. It uses only
+// additions, comparisons and one 32 bit multiplication (no division).
+// When a window is complete, the sums are saved and a new window starts.
+// The divisions and the square root are done later, in the main loop,
+// by sig_stats_read().
+//
+// To keep the sums small, the first sample of a window is used as an
+// offset and only (sample - offset) is accumulated (shifted data method).
+
+#ifndef _SIG_STATS_H_
+#define _SIG_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIG_STATS_CHANNELS 12U       // One accumulator per ADC channel.
+#define SIG_STATS_WINDOW_DEFAULT 100U
+#define SIG_STATS_WINDOW_MAX 65535U  // Sums of 12 bit samples fit in 32 bits.
+
+// Sums of one window.
+typedef struct {
+  uint32_t count;
+  uint16_t offset;   // First sample of the window.
+  uint16_t min;
+  uint16_t max;
+  int32_t sum;       // Sum of (sample - offset).
+  uint64_t sumSq;    // Sum of (sample - offset)^2.
+} sig_stats_acc_t;
+
+// Results of one window, in ADC counts.
+typedef struct {
+  uint32_t count;
+  uint16_t min;
+  uint16_t max;
+  uint16_t peakToPeak;
+  uint16_t mean;
+  uint16_t rms;
+  uint32_t variance;
+} sig_stats_result_t;
+
+void sig_stats_init(uint32_t window);
+
+// New window length. Used from the next window of each channel.
+bool sig_stats_set_window(uint32_t window);
+uint32_t sig_stats_get_window(void);
+
+// Add one sample of a channel (called from the ADC ISR).
+void sig_stats_add(uint32_t channel, uint16_t sample);
+
+// If a window of the channel is complete, calculate its results and
+// return true. Each window is returned only once.
+bool sig_stats_read(uint32_t channel, sig_stats_result_t *result);
+
+// Results from the sums of a window.
+void sig_stats_compute(const sig_stats_acc_t *acc, sig_stats_result_t *result);
+
+// Number of complete windows that were not read in time.
+uint32_t sig_stats_overwritten(void);
+
+#endif // _SIG_STATS_H_
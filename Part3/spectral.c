@@ -0,0 +1,229 @@
+// Integer spectral analysis: Goertzel and radix-2 FFT. See spectral.h.
+
+#include "spectral.h"
+
+#define SPECTRAL_QUARTER (SPECTRAL_MAX_N / 4U)
+// 0.5 in Q15 and Q29: the products are rounded, not truncated. Truncation
+// always rounds down, and its error adds up over the FFT stages.
+#define ROUND_15 (1 << 14)
+#define ROUND_29 (1 << 28)
+
+// sin(2*pi*i/256) in Q15, for i = 0 .. 191 (three quarters of a period,
+// so that cos(x) = sin(x + quarter) can be read from the same table).
+// 1.0 is stored as 32767. Generated with:
+//   round(32768 * sin(2 * pi * i / 256))
+static const int16_t sinTable[SPECTRAL_MAX_N * 3U / 4U] = {
+       0,    804,   1608,   2411,   3212,   4011,   4808,   5602,
+    6393,   7180,   7962,   8740,   9512,  10279,  11039,  11793,
+   12540,  13279,  14010,  14733,  15447,  16151,  16846,  17531,
+   18205,  18868,  19520,  20160,  20788,  21403,  22006,  22595,
+   23170,  23732,  24279,  24812,  25330,  25833,  26320,  26791,
+   27246,  27684,  28106,  28511,  28899,  29269,  29622,  29957,
+   30274,  30572,  30853,  31114,  31357,  31581,  31786,  31972,
+   32138,  32286,  32413,  32522,  32610,  32679,  32729,  32758,
+   32767,  32758,  32729,  32679,  32610,  32522,  32413,  32286,
+   32138,  31972,  31786,  31581,  31357,  31114,  30853,  30572,
+   30274,  29957,  29622,  29269,  28899,  28511,  28106,  27684,
+   27246,  26791,  26320,  25833,  25330,  24812,  24279,  23732,
+   23170,  22595,  22006,  21403,  20788,  20160,  19520,  18868,
+   18205,  17531,  16846,  16151,  15447,  14733,  14010,  13279,
+   12540,  11793,  11039,  10279,   9512,   8740,   7962,   7180,
+    6393,   5602,   4808,   4011,   3212,   2411,   1608,    804,
+       0,   -804,  -1608,  -2411,  -3212,  -4011,  -4808,  -5602,
+   -6393,  -7180,  -7962,  -8740,  -9512, -10279, -11039, -11793,
+  -12540, -13279, -14010, -14733, -15447, -16151, -16846, -17531,
+  -18205, -18868, -19520, -20160, -20788, -21403, -22006, -22595,
+  -23170, -23732, -24279, -24812, -25330, -25833, -26320, -26791,
+  -27246, -27684, -28106, -28511, -28899, -29269, -29622, -29957,
+  -30274, -30572, -30853, -31114, -31357, -31581, -31786, -31972,
+  -32138, -32286, -32413, -32522, -32610, -32679, -32729, -32758,
+};
+
+
+// cos(2*pi*i/256) in Q30, for i = 0 .. 64 (one quarter of a period), for
+// the Goertzel coefficient. 15 bits are not enough there: its error is
+// multiplied by the resonance of the recursion. Generated with:
+//   round(2^30 * cos(2 * pi * i / 256))
+static const int32_t cosTableQ30[SPECTRAL_QUARTER + 1U] = {
+   1073741824,  1073418433,  1072448455,  1070832474,  1068571464,
+   1065666786,  1062120190,  1057933813,  1053110176,  1047652185,
+   1041563127,  1034846671,  1027506862,  1019548121,  1010975242,
+   1001793390,   992008094,   981625251,   970651112,   959092290,
+    946955747,   934248793,   920979082,   907154608,   892783698,
+    877875009,   862437520,   846480531,   830013654,   813046808,
+    795590213,   777654384,   759250125,   740388522,   721080937,
+    701339000,   681174602,   660599890,   639627258,   618269338,
+    596538995,   574449320,   552013618,   529245404,   506158392,
+    482766489,   459083786,   435124548,   410903207,   386434353,
+    361732726,   336813204,   311690799,   286380643,   260897982,
+    235258165,   209476638,   183568930,   157550647,   131437462,
+    105245103,    78989349,    52686014,    26350943,           0,
+};
+
+
+// sin(2*pi*i/SPECTRAL_MAX_N) for any i, using the symmetry
+// sin(x) = -sin(x - pi) for the last quarter.
+static inline int32_t sin_q15(uint32_t i) {
+  i &= (SPECTRAL_MAX_N - 1U);
+  if (i >= (SPECTRAL_MAX_N * 3U / 4U)) {
+    return -sinTable[i - (SPECTRAL_MAX_N / 2U)];
+  }
+  return sinTable[i];
+}
+
+static inline int32_t cos_q15(uint32_t i) {
+  return sin_q15(i + SPECTRAL_QUARTER);
+}
+
+// cos(2*pi*i/SPECTRAL_MAX_N) in Q30 for any i, from the quarter table
+// with cos(x) = cos(-x) and cos(x) = -cos(pi - x).
+static int32_t cos_q30(uint32_t i) {
+  i &= (SPECTRAL_MAX_N - 1U);
+  if (i > (SPECTRAL_MAX_N / 2U)) {
+    i = SPECTRAL_MAX_N - i;
+  }
+  if (i > SPECTRAL_QUARTER) {
+    return -cosTableQ30[(SPECTRAL_MAX_N / 2U) - i];
+  }
+  return cosTableQ30[i];
+}
+
+// log2(n) for the supported sizes, 0 if n is not supported.
+static uint32_t fft_log2(uint32_t n) {
+  switch (n) {
+  case 64:  return 6;
+  case 128: return 7;
+  case 256: return 8;
+  default:  return 0;
+  }
+}
+
+
+bool spectral_fft(int16_t *re, int16_t *im, uint32_t n) {
+
+  uint32_t i, j, bit;
+  uint32_t len, half, step;
+  uint32_t a, b;
+  int32_t wr, wi, tr, ti;
+  int16_t tmp;
+
+  if (fft_log2(n) == 0U) {
+    return false;
+  }
+
+  // Bit reversed order of the input (decimation in time).
+  j = 0;
+  for (i = 0; i < n; i++) {
+    im[i] = 0;
+  }
+  for (i = 1; i < n; i++) {
+    bit = n >> 1;
+    while (j & bit) {
+      j ^= bit;
+      bit >>= 1;
+    }
+    j ^= bit;
+    if (i < j) {
+      tmp = re[i];
+      re[i] = re[j];
+      re[j] = tmp;
+    }
+  }
+
+  // Butterflies. Every stage divides by 2 (rounded) to avoid overflow.
+  for (len = 2; len <= n; len <<= 1) {
+    half = len >> 1;
+    step = SPECTRAL_MAX_N / len;   // Twiddle table stride for this stage.
+    for (j = 0; j < half; j++) {
+      // W = exp(-i*2*pi*j/len)
+      wr = cos_q15(j * step);
+      wi = -sin_q15(j * step);
+      for (i = j; i < n; i += len) {
+	a = i;
+	b = i + half;
+	tr = (wr * re[b] - wi * im[b] + ROUND_15) >> 15;
+	ti = (wr * im[b] + wi * re[b] + ROUND_15) >> 15;
+	re[b] = (int16_t)((re[a] - tr + 1) >> 1);
+	im[b] = (int16_t)((im[a] - ti + 1) >> 1);
+	re[a] = (int16_t)((re[a] + tr + 1) >> 1);
+	im[a] = (int16_t)((im[a] + ti + 1) >> 1);
+      }
+    }
+  }
+
+  return true;
+}
+
+
+uint64_t spectral_band_energy(const int16_t *re, const int16_t *im,
+			      uint32_t first, uint32_t last) {
+  uint64_t energy = 0;
+  uint32_t k;
+
+  for (k = first; k <= last; k++) {
+    energy += spectral_power(re, im, k);
+  }
+  return energy;
+}
+
+
+uint32_t spectral_peak_bin(const int16_t *re, const int16_t *im, uint32_t n) {
+  uint32_t k;
+  uint32_t peak = 1;
+  uint32_t peakPower = 0;
+  uint32_t power;
+
+  for (k = 1; k < (n / 2U); k++) {
+    power = spectral_power(re, im, k);
+    if (power > peakPower) {
+      peakPower = power;
+      peak = k;
+    }
+  }
+  return peak;
+}
+
+
+uint32_t spectral_goertzel(const int16_t *x, uint32_t n, uint32_t k) {
+
+  uint32_t log2n = fft_log2(n);
+  // coeff = 2*cos(2*pi*k/n) in Q29, which is cos() in Q30.
+  int32_t coeff = cos_q30(k * (SPECTRAL_MAX_N / n));
+  int32_t s0;
+  int32_t s1 = 0;
+  int32_t s2 = 0;
+  int64_t power;
+  uint32_t i;
+
+  if (log2n == 0U) {
+    return 0;
+  }
+
+  // s[i] = x[i] + 2*cos(w)*s[i-1] - s[i-2]
+  // s grows with n, so the product with coeff needs 64 bits.
+  for (i = 0; i < n; i++) {
+    s0 = x[i] + (int32_t)(((int64_t)coeff * s1 + ROUND_29) >> 29) - s2;
+    s2 = s1;
+    s1 = s0;
+  }
+
+  // |X[k]|^2 = s1^2 + s2^2 - 2*cos(w)*s1*s2, divided by n^2 to match the
+  // scale of spectral_fft().
+  power = (int64_t)s1 * s1 + (int64_t)s2 * s2 -
+	  (((int64_t)coeff * s1 + ROUND_29) >> 29) * s2;
+  if (power < 0) {
+    power = 0;   // Rounding error of a very small result.
+  }
+  return (uint32_t)((uint64_t)power >> (2U * log2n));
+}
+
+
+void spectral_goertzel_bins(const int16_t *x, uint32_t n,
+			    const uint16_t *bins, uint32_t nbins,
+			    uint32_t *power) {
+  uint32_t i;
+
+  for (i = 0; i < nbins; i++) {
+    power[i] = spectral_goertzel(x, n, bins[i]);
+  }
+}
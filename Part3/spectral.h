@@ -0,0 +1,60 @@
+// Integer spectral analysis of ADC blocks: Goertzel tone detector and
+// radix-2 FFT in Q15 fixed point. No floating point is used.
+//
+// Samples are Q15 numbers (-32768 .. 32767 means -1.0 .. +1.0).
+// spectral_from_adc() converts 12 bit ADC results to this format.
+//
+// The FFT divides by 2 at every stage so that it never overflows:
+// the result is FFT(x) / N. A full scale sine of bin k gives
+// re^2+im^2 = (32768/2)^2 in bins k and N-k.
+//
+// The cos/sin values of the FFT come from one Q15 table in flash, made
+// for SPECTRAL_MAX_N points; smaller transforms use every 2nd or 4th
+// entry. The Goertzel coefficient comes from a Q30 cos table.
+//
+// Accuracy against a double precision DFT (test/test_spectral.c):
+//  - FFT: under 5 LSB of Q15 in every bin, for full scale sines and noise.
+//  - Goertzel: under 1 LSB of |X[k]| in every bin, for full scale sines.
+
+#ifndef _SPECTRAL_H_
+#define _SPECTRAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SPECTRAL_MIN_N 64U
+#define SPECTRAL_MAX_N 256U
+
+// Convert a 12 bit ADC result to Q15, removing the mid-scale offset.
+static inline int16_t spectral_from_adc(uint32_t result) {
+  return (int16_t)(((int32_t)result - 2048) << 4);
+}
+
+// In-place FFT of n points (64, 128 or 256).
+// re[] holds the samples on entry; im[] is cleared by the function.
+// Returns false if n is not supported.
+bool spectral_fft(int16_t *re, int16_t *im, uint32_t n);
+
+// |X[k]|^2 = re^2 + im^2 of one FFT bin.
+static inline uint32_t spectral_power(const int16_t *re, const int16_t *im,
+				      uint32_t k) {
+  return (uint32_t)((int32_t)re[k] * re[k]) + (uint32_t)((int32_t)im[k] * im[k]);
+}
+
+// Sum of |X[k]|^2 for k = first .. last, e.g. energy of a vibration band.
+uint64_t spectral_band_energy(const int16_t *re, const int16_t *im,
+			      uint32_t first, uint32_t last);
+
+// Index of the strongest bin in 1 .. n/2-1 (the DC bin is skipped).
+uint32_t spectral_peak_bin(const int16_t *re, const int16_t *im, uint32_t n);
+
+// Goertzel detector for one bin k of an n point block.
+// The result is |X[k]|^2 on the same scale as spectral_power().
+uint32_t spectral_goertzel(const int16_t *x, uint32_t n, uint32_t k);
+
+// Goertzel for several bins of the same block.
+void spectral_goertzel_bins(const int16_t *x, uint32_t n,
+			    const uint16_t *bins, uint32_t nbins,
+			    uint32_t *power);
+
+#endif // _SPECTRAL_H_
@@ -0,0 +1,304 @@
+// Streaming acquisition from an external SPI ADC. See spi_adc.h.
+
+#include "fsl_device_registers.h"
+#include "fsl_clock.h"
+#include "fsl_spi.h"
+#include "fsl_dma.h"
+#include "fsl_sctimer.h"
+#include "spi_adc.h"
+
+// DMA channels requested by SPI0. See: Table "DMA requests" in the User Manual.
+#define SPI_ADC_RX_CHANNEL 6U
+#define SPI_ADC_TX_CHANNEL 7U
+
+// DMA trigger input "SCT0 DMA request 0". See: DMA trigger input mux.
+#define DMA_TRIG_SCT0_DMA0 2U
+
+#define SPI_ADC_SSEL 0U
+#define SPI_ADC_CNVST_OUT kSCTIMER_Out_5
+#define SPI_ADC_GAP_TICKS 16U   // DMA and SPI start up, per sample.
+#define SPI_ADC_RING_FRAMES (SPI_ADC_NUM_BLOCKS * SPI_ADC_BLOCK_LEN)
+
+// The TX channel repeats one descriptor of DMA_MAX_TRANSFER_COUNT words, so
+// its transfer count is the number of frames modulo the ring length:
+_Static_assert((DMA_MAX_TRANSFER_COUNT % SPI_ADC_RING_FRAMES) == 0U,
+	       "the TX descriptor must be a multiple of the ring");
+
+static spi_adc_config_t adcConfig;
+static uint32_t coreClock;
+static uint32_t txWord;    // TXDATCTL of every frame, copied by the DMA.
+
+static uint16_t blocks[SPI_ADC_NUM_BLOCKS][SPI_ADC_BLOCK_LEN];
+static spi_adc_ring_t ring;
+static volatile uint32_t dmaBlock;   // The oldest block not marked full.
+static int32_t readBlock = -1;       // The block the main loop is reading.
+
+static dma_handle_t rxHandle;
+static dma_handle_t txHandle;
+// Linked descriptors, reloaded by the DMA without CPU work:
+// RX goes through all blocks in turn, TX repeats the same word for ever.
+SDK_ALIGN(static dma_descriptor_t rxDesc[SPI_ADC_NUM_BLOCKS],
+	  FSL_FEATURE_DMA_LINK_DESCRIPTOR_ALIGN_SIZE);
+SDK_ALIGN(static dma_descriptor_t txDesc,
+	  FSL_FEATURE_DMA_LINK_DESCRIPTOR_ALIGN_SIZE);
+
+static uint32_t periodEvent;   // Counter H limit, CNVST high.
+static uint32_t readEvent;     // Conversion done: CNVST low, start the frame.
+static uint32_t savedPrescaleH;
+static uint32_t rate;
+static bool running;
+
+
+// Frames still to be moved by the current descriptor of a DMA channel.
+// See: 12.6.18 Transfer Configuration registers, XFERCOUNT field.
+static uint32_t dma_remaining(uint32_t channel) {
+  return ((DMA0->CHANNEL[channel].XFERCFG & DMA_CHANNEL_XFERCFG_XFERCOUNT_MASK) >>
+	  DMA_CHANNEL_XFERCFG_XFERCOUNT_SHIFT) + 1U;
+}
+
+
+// The block the RX channel is writing now, from the DMA transfer counts.
+// TX has started 'sent' frames (modulo the ring); the last one may still
+// be on the bus, so RX has received 'sent' or 'sent'-1 of them. The RX
+// count in the current block tells which one.
+static uint32_t rx_writing_block(void) {
+
+  uint32_t sent;
+  uint32_t inBlock;
+  uint32_t received;
+
+  // A new frame starts at most once per sample period: read again if it
+  // started while RX was read.
+  do {
+    sent = DMA_MAX_TRANSFER_COUNT - dma_remaining(SPI_ADC_TX_CHANNEL);
+    inBlock = SPI_ADC_BLOCK_LEN - dma_remaining(SPI_ADC_RX_CHANNEL);
+  } while (sent != (DMA_MAX_TRANSFER_COUNT - dma_remaining(SPI_ADC_TX_CHANNEL)));
+
+  received = sent % SPI_ADC_RING_FRAMES;
+  if ((received % SPI_ADC_BLOCK_LEN) != inBlock) {
+    received = (received + SPI_ADC_RING_FRAMES - 1U) % SPI_ADC_RING_FRAMES;
+  }
+  return received / SPI_ADC_BLOCK_LEN;
+}
+
+
+// Called by the DMA driver ISR when a block is full.
+// The DMA has one interrupt flag per channel: if the ISR was blocked for
+// longer than a block, the blocks finished meanwhile give one interrupt.
+// So all blocks up to the one the DMA is writing now are marked full, in
+// order. (If the ISR was blocked for the whole ring, the blocks can not
+// be told apart any more; their data was written again anyway.)
+static void rx_block_done(dma_handle_t *handle, void *param,
+			  bool transferDone, uint32_t intmode) {
+
+  uint32_t writing = rx_writing_block();
+
+  while (dmaBlock != writing) {
+    spi_adc_ring_complete(&ring, dmaBlock);
+    dmaBlock = (dmaBlock + 1U) % SPI_ADC_NUM_BLOCKS;
+  }
+}
+
+
+// Write the match value of a counter H event (upper half of the register).
+// See: 16.6.20 and 16.6.21 SCT match and match reload registers.
+static void set_match_h(uint32_t event, uint32_t value) {
+
+  uint32_t reg = SCT0->EV[event].CTRL & SCT_EV_CTRL_MATCHSEL_MASK;
+
+  // 16 bit writes: the lower half belongs to a counter L event.
+  SCT0->MATCH_ACCESS16BIT[reg].MATCHH = (uint16_t)value;
+  SCT0->MATCHREL_ACCESS16BIT[reg].MATCHRELH = (uint16_t)value;
+}
+
+
+status_t spi_adc_init(const spi_adc_config_t *config, uint32_t coreClock_Hz) {
+
+  spi_master_config_t spiConfig;
+  dma_channel_trigger_t trigger;
+
+  if (!spi_adc_format_valid(&config->format) || (config->spiClockHz == 0U)) {
+    return kStatus_InvalidArgument;
+  }
+  adcConfig = *config;
+  coreClock = coreClock_Hz;
+  txWord = spi_adc_txdatctl(&config->format, SPI_ADC_SSEL);
+
+  // SPI0 master. The frame length and SSEL come from the TXDATCTL word.
+  SPI_MasterGetDefaultConfig(&spiConfig);
+  spiConfig.baudRate_Bps = config->spiClockHz;
+  spiConfig.dataWidth = (spi_data_width_t)(config->format.frameBits - 1U);
+  spiConfig.clockPolarity = config->clockIdleHigh ?
+			    kSPI_ClockPolarityActiveLow : kSPI_ClockPolarityActiveHigh;
+  spiConfig.clockPhase = config->sampleSecondEdge ?
+			 kSPI_ClockPhaseSecondEdge : kSPI_ClockPhaseFirstEdge;
+  SPI_MasterInit(SPI0, &spiConfig, coreClock_Hz);
+
+  // RX: one frame per SPI0 RXRDY request.
+  DMA_EnableChannel(DMA0, SPI_ADC_RX_CHANNEL);
+  DMA_EnableChannelPeriphRq(DMA0, SPI_ADC_RX_CHANNEL);
+  DMA_CreateHandle(&rxHandle, DMA0, SPI_ADC_RX_CHANNEL);
+  DMA_SetCallback(&rxHandle, rx_block_done, NULL);
+
+  // TX: one word per SCT trigger (and SPI0 TXRDY).
+  DMA_EnableChannel(DMA0, SPI_ADC_TX_CHANNEL);
+  DMA_EnableChannelPeriphRq(DMA0, SPI_ADC_TX_CHANNEL);
+  trigger.type = kDMA_RisingEdgeTrigger;
+  trigger.burst = kDMA_EdgeBurstTransfer1;
+  trigger.wrap = kDMA_NoWrap;
+  DMA_ConfigureChannelTrigger(DMA0, SPI_ADC_TX_CHANNEL, &trigger);
+  DMA_CreateHandle(&txHandle, DMA0, SPI_ADC_TX_CHANNEL);
+  INPUTMUX->DMA_ITRIG_INMUX[SPI_ADC_TX_CHANNEL] = DMA_TRIG_SCT0_DMA0;
+
+  // Counter H events. They are disabled (no state) until spi_adc_start().
+  SCTIMER_CreateAndScheduleEvent(SCT0, kSCTIMER_MatchEventOnly, 0xFFFFU, 0,
+				 kSCTIMER_Counter_H, &periodEvent);
+  SCT0->EV[periodEvent].STATE = 0;
+  SCTIMER_SetupCounterLimitAction(SCT0, kSCTIMER_Counter_H, periodEvent);
+  SCTIMER_SetupOutputSetAction(SCT0, SPI_ADC_CNVST_OUT, periodEvent);
+
+  SCTIMER_CreateAndScheduleEvent(SCT0, kSCTIMER_MatchEventOnly, 0xFFFFU, 0,
+				 kSCTIMER_Counter_H, &readEvent);
+  SCT0->EV[readEvent].STATE = 0;
+  SCTIMER_SetupOutputClearAction(SCT0, SPI_ADC_CNVST_OUT, readEvent);
+
+  return kStatus_Success;
+}
+
+
+status_t spi_adc_start(uint32_t rateHz) {
+
+  uint32_t ticks;
+  uint32_t convTicks;
+  uint32_t frameTicks;
+  uint32_t xfer;
+  uint32_t b;
+
+  if (rateHz == 0U) {
+    return kStatus_InvalidArgument;
+  }
+  ticks = coreClock / rateHz;  // Counter H runs at the core clock.
+  convTicks = (((coreClock / 1000U) * adcConfig.conversionNs) / 1000000U) + 1U;
+  frameTicks = ((adcConfig.format.frameBits * coreClock) / adcConfig.spiClockHz) +
+	       SPI_ADC_GAP_TICKS;
+  if ((ticks > 0x10000U) || (ticks <= (convTicks + frameTicks))) {
+    return kStatus_InvalidArgument;  // Too slow for 16 bits, or too fast.
+  }
+
+  if (running) {
+    spi_adc_stop();
+  }
+  SCTIMER_StopTimer(SCT0, kSCTIMER_Counter_H);
+
+  // Counter H without prescaler, from 0. See: 16.6.3 SCT control register.
+  savedPrescaleH = SCT0->CTRL & SCT_CTRL_PRE_H_MASK;
+  SCT0->CTRL = (SCT0->CTRL & ~SCT_CTRL_PRE_H_MASK) | SCT_CTRL_CLRCTR_H_MASK;
+  set_match_h(periodEvent, ticks - 1U);
+  set_match_h(readEvent, convTicks);
+
+  // Old frames out of the SPI:
+  while (SPI0->STAT & SPI_STAT_RXRDY_MASK) {
+    (void)SPI0->RXDAT;
+  }
+
+  spi_adc_ring_reset(&ring);
+  dmaBlock = 0;
+  readBlock = -1;
+
+  xfer = DMA_CHANNEL_XFER(true, false, true, false, sizeof(uint16_t),
+			  kDMA_AddressInterleave0xWidth, kDMA_AddressInterleave1xWidth,
+			  sizeof(blocks[0]));
+  for (b = 0; b < SPI_ADC_NUM_BLOCKS; b++) {
+    DMA_SetupDescriptor(&rxDesc[b], xfer, (void *)&SPI0->RXDAT, blocks[b],
+			&rxDesc[(b + 1U) % SPI_ADC_NUM_BLOCKS]);
+  }
+  DMA_SubmitChannelTransferParameter(&rxHandle, xfer, (void *)&SPI0->RXDAT,
+				     blocks[0], &rxDesc[1]);
+  DMA_StartTransfer(&rxHandle);
+
+  xfer = DMA_CHANNEL_XFER(true, false, false, false, sizeof(uint32_t),
+			  kDMA_AddressInterleave0xWidth, kDMA_AddressInterleave0xWidth,
+			  sizeof(uint32_t) * DMA_MAX_TRANSFER_COUNT);
+  DMA_SetupDescriptor(&txDesc, xfer, &txWord, (void *)&SPI0->TXDATCTL, &txDesc);
+  DMA_SubmitChannelTransferParameter(&txHandle, xfer, &txWord,
+				     (void *)&SPI0->TXDATCTL, &txDesc);
+  DMA_StartTransfer(&txHandle);
+
+  // See: 16.6.14 SCT DMA request 0 register.
+  SCT0->DMAREQ0 = 1U << readEvent;
+  SCT0->EV[periodEvent].STATE = 1U;   // Enabled in state 0.
+  SCT0->EV[readEvent].STATE = 1U;
+
+  rate = coreClock / ticks;
+  running = true;
+  SCTIMER_StartTimer(SCT0, kSCTIMER_Counter_H);
+  return kStatus_Success;
+}
+
+
+void spi_adc_stop(void) {
+
+  if (!running) {
+    return;
+  }
+  // The OUTPUT register must not be written while counter L (the PWM) runs.
+  // CNVST is brought low by the SCT itself: no new period and no new frame,
+  // and the read event of the current period clears the output (in at most
+  // one period). See: 16.6.12 SCT output register.
+  SCT0->DMAREQ0 = 0;
+  SCT0->EV[periodEvent].STATE = 0;
+  while ((SCT0->OUTPUT & (1U << SPI_ADC_CNVST_OUT)) != 0U) {
+  }
+  SCTIMER_StopTimer(SCT0, kSCTIMER_Counter_H);
+  SCT0->EV[readEvent].STATE = 0;
+
+  DMA_AbortTransfer(&txHandle);
+  DMA_AbortTransfer(&rxHandle);
+
+  SCT0->CTRL = (SCT0->CTRL & ~SCT_CTRL_PRE_H_MASK) | savedPrescaleH |
+	       SCT_CTRL_CLRCTR_H_MASK;
+  running = false;
+  SCTIMER_StartTimer(SCT0, kSCTIMER_Counter_H);
+}
+
+
+uint32_t spi_adc_rate(void) {
+  return rate;
+}
+
+
+const uint16_t *spi_adc_get_block(void) {
+
+  uint32_t primask;
+
+  if (readBlock < 0) {
+    primask = DisableGlobalIRQ();
+    readBlock = spi_adc_ring_get(&ring);
+    EnableGlobalIRQ(primask);
+  }
+  return (readBlock < 0) ? NULL : blocks[readBlock];
+}
+
+
+void spi_adc_release_block(void) {
+
+  uint32_t primask;
+
+  if (readBlock < 0) {
+    return;
+  }
+  primask = DisableGlobalIRQ();
+  spi_adc_ring_release(&ring, (uint32_t)readBlock);
+  EnableGlobalIRQ(primask);
+  readBlock = -1;
+}
+
+
+const spi_adc_format_t *spi_adc_format(void) {
+  return &adcConfig.format;
+}
+
+
+uint32_t spi_adc_overruns(void) {
+  return ring.overruns;
+}
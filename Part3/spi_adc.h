@@ -0,0 +1,60 @@
+// Streaming acquisition from an external SPI ADC with DMA.
+//
+// No CPU work is done per sample; only once per block in the DMA ISR.
+//  - SCT counter H sets the sampling period. Its output OUT5 is the
+//    conversion start (CNVST) of the ADC: high at the start of the
+//    period, low after the conversion time.
+//  - The event at the end of the conversion makes SCT DMA request 0.
+//    It triggers DMA channel 7 (SPI0 TX), which writes one TXDATCTL word
+//    to SPI0: SPI0 asserts SSEL0 and clocks one frame.
+//  - DMA channel 6 (SPI0 RX) copies the received frames into the blocks
+//    of the ring buffer (see spi_adc_frame.h).
+//
+// While the SPI ADC runs, counter H is not available for the on-chip ADC
+// trigger: the two sources can not be used at the same time.
+//
+// If the DMA ISR is blocked for longer than one block (e.g. while the flash
+// is written), the blocks finished meanwhile are found from the transfer
+// counts of the DMA channels, so the block order is kept.
+//
+// Pins: SCK P0_24, MISO P0_25, SSEL0 P0_26, CNVST P0_27 (see board_pins.h).
+
+#ifndef _SPI_ADC_H_
+#define _SPI_ADC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fsl_common.h"
+#include "spi_adc_frame.h"
+
+typedef struct {
+  spi_adc_format_t format;
+  uint32_t spiClockHz;     // SCK frequency.
+  uint32_t conversionNs;   // CNVST high time, before the frame is read.
+  bool clockIdleHigh;      // SPI mode 2 or 3.
+  bool sampleSecondEdge;   // SPI mode 1 or 3.
+} spi_adc_config_t;
+
+// Set up SPI0, the pins, the DMA channels and the SCT events. The
+// acquisition is not started. Must be called after DMA_Init()
+// (uart_dma_init()) and before SCT0 is started.
+status_t spi_adc_init(const spi_adc_config_t *config, uint32_t coreClock_Hz);
+
+// Start (or restart with a new rate) the acquisition. Counter H is taken
+// from the on-chip ADC trigger until spi_adc_stop().
+status_t spi_adc_start(uint32_t rateHz);
+
+// Stop the acquisition and give counter H back as it was.
+void spi_adc_stop(void);
+
+uint32_t spi_adc_rate(void);   // Actual sampling rate (Hz).
+
+// The oldest full block of SPI_ADC_BLOCK_LEN frames, or NULL.
+// Use spi_adc_decode() for the results, then spi_adc_release_block().
+const uint16_t *spi_adc_get_block(void);
+void spi_adc_release_block(void);
+
+const spi_adc_format_t *spi_adc_format(void);
+uint32_t spi_adc_overruns(void);
+
+#endif // _SPI_ADC_H_
@@ -0,0 +1,71 @@
+// Frame format and block buffers of the SPI ADC. See spi_adc_frame.h.
+
+#include "spi_adc_frame.h"
+
+// SPI Transmitter Data and Control register fields.
+// See: 18.6.7 SPI Transmitter Data and Control register, in the User Manual.
+#define TXDATCTL_TXSSEL_N_SHIFT 16U  // 4 bits; 0 asserts SSELn.
+#define TXDATCTL_EOT (1U << 20)      // Release SSEL after this frame.
+#define TXDATCTL_LEN_SHIFT 24U       // Frame length - 1.
+
+#define NEXT_BLOCK(b) (((b) + 1U) % SPI_ADC_NUM_BLOCKS)
+
+
+bool spi_adc_format_valid(const spi_adc_format_t *format) {
+  return (format->frameBits >= 1U) && (format->frameBits <= 16U) &&
+	 (format->dataBits >= 1U) &&
+	 ((format->dataBits + format->dataShift) <= format->frameBits);
+}
+
+
+uint32_t spi_adc_txdatctl(const spi_adc_format_t *format, uint32_t ssel) {
+  return (((0xFU & ~(1U << ssel)) << TXDATCTL_TXSSEL_N_SHIFT) |
+	  TXDATCTL_EOT |
+	  ((uint32_t)(format->frameBits - 1U) << TXDATCTL_LEN_SHIFT));
+}
+
+
+void spi_adc_ring_reset(spi_adc_ring_t *ring) {
+  ring->full = 0;
+  ring->next = 0;
+  ring->overruns = 0;
+}
+
+
+void spi_adc_ring_complete(spi_adc_ring_t *ring, uint32_t block) {
+
+  uint8_t overwritten = (uint8_t)(1U << NEXT_BLOCK(block));
+
+  // The DMA is now writing the next block. If it was still full, its
+  // samples are being lost:
+  if (ring->full & overwritten) {
+    ring->full &= (uint8_t)~overwritten;
+    ring->overruns++;
+  }
+  ring->full |= (uint8_t)(1U << block);
+}
+
+
+int32_t spi_adc_ring_get(spi_adc_ring_t *ring) {
+
+  uint8_t full = ring->full;
+  uint32_t block = ring->next;
+  uint32_t i;
+
+  // Blocks are filled in order, so the first full one from 'next' on is
+  // the oldest. (It is not 'next' itself if that one was dropped.)
+  for (i = 0; i < SPI_ADC_NUM_BLOCKS; i++) {
+    if (full & (1U << block)) {
+      ring->next = (uint8_t)block;
+      return (int32_t)block;
+    }
+    block = NEXT_BLOCK(block);
+  }
+  return -1;
+}
+
+
+void spi_adc_ring_release(spi_adc_ring_t *ring, uint32_t block) {
+  ring->full &= (uint8_t)~(1U << block);   // The caller disables the DMA ISR.
+  ring->next = (uint8_t)NEXT_BLOCK(block);
+}
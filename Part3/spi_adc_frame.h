@@ -0,0 +1,63 @@
+// Frame format and block buffers of the external SPI ADC driver (spi_adc.h).
+//
+// This part does not access the hardware, so it can also be compiled on a
+// PC and tested with a model of the SPI ADC.
+//
+// The DMA writes the received SPI frames into SPI_ADC_NUM_BLOCKS blocks,
+// one after the other, and starts again with the first. When a block is
+// full, the DMA ISR marks it "full" (spi_adc_ring_complete()). The main
+// loop takes the oldest full block (spi_adc_ring_get()) and gives it back
+// when it is done (spi_adc_ring_release()).
+// If the main loop is too slow, the DMA writes into a block that is still
+// full: that block is dropped and counted as an overrun.
+
+#ifndef _SPI_ADC_FRAME_H_
+#define _SPI_ADC_FRAME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SPI_ADC_BLOCK_LEN 64U   // Samples per block.
+#define SPI_ADC_NUM_BLOCKS 4U   // At most 8.
+
+// Where the result is in the received frame:
+//   frame bits:  | leading bits | dataBits | dataShift bits |
+typedef struct {
+  uint8_t frameBits;   // SPI frame length, 1 .. 16.
+  uint8_t dataBits;    // Length of the result.
+  uint8_t dataShift;   // Bits after the result (LSB side).
+} spi_adc_format_t;
+
+typedef struct {
+  volatile uint8_t full;       // Bit n: block n is full.
+  uint8_t next;                // The block the main loop reads next.
+  volatile uint32_t overruns;  // Blocks dropped.
+} spi_adc_ring_t;
+
+bool spi_adc_format_valid(const spi_adc_format_t *format);
+
+// The word written to the SPI TXDATCTL register for one frame: frame
+// length, the slave select 'ssel' (0 .. 3) asserted during the frame and
+// released at the end (EOT). The transmitted data is 0.
+uint32_t spi_adc_txdatctl(const spi_adc_format_t *format, uint32_t ssel);
+
+// Result from a received frame.
+static inline uint16_t spi_adc_decode(const spi_adc_format_t *format,
+				      uint16_t frame) {
+  return (uint16_t)((frame >> format->dataShift) &
+		    ((1U << format->dataBits) - 1U));
+}
+
+void spi_adc_ring_reset(spi_adc_ring_t *ring);
+
+// Called by the DMA ISR when 'block' is full. The DMA continues with
+// the next block.
+void spi_adc_ring_complete(spi_adc_ring_t *ring, uint32_t block);
+
+// The oldest full block, or -1 if none is full.
+int32_t spi_adc_ring_get(spi_adc_ring_t *ring);
+
+// Must not be interrupted by spi_adc_ring_complete().
+void spi_adc_ring_release(spi_adc_ring_t *ring, uint32_t block);
+
+#endif // _SPI_ADC_FRAME_H_
@@ -0,0 +1,19 @@
+// Host stand-in for the SDK's fsl_common.h: only the status codes used by
+// the modules under test (same values as the SDK).
+
+#ifndef _FSL_COMMON_H_
+#define _FSL_COMMON_H_
+
+#include <stdint.h>
+
+typedef int32_t status_t;
+
+enum {
+  kStatus_Success = 0,
+  kStatus_Fail = 1,
+  kStatus_ReadOnly = 2,
+  kStatus_OutOfRange = 3,
+  kStatus_InvalidArgument = 4,
+};
+
+#endif // _FSL_COMMON_H_
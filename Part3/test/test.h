@@ -0,0 +1,33 @@
+// Minimal checks for the host tests of the pure (hardware free) modules.
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+
+static int testFailures;
+
+#define CHECK(cond)							\
+  do {									\
+    if (!(cond)) {							\
+      printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond);	\
+      testFailures++;							\
+    }									\
+  } while (0)
+
+#define CHECK_EQ(a, b)							\
+  do {									\
+    long long a_ = (long long)(a);					\
+    long long b_ = (long long)(b);					\
+    if (a_ != b_) {							\
+      printf("%s:%d: CHECK_EQ failed: %s == %lld, %s == %lld\n",	\
+	     __FILE__, __LINE__, #a, a_, #b, b_);			\
+      testFailures++;							\
+    }									\
+  } while (0)
+
+// Return value of main().
+#define TEST_RESULT()							\
+  ((testFailures == 0) ? (printf("%s: OK\n", __FILE__), 0) : 1)
+
+#endif // _TEST_H_
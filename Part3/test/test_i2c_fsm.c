@@ -0,0 +1,193 @@
+// Host test of the I2C transaction queue and state machine (i2c_fsm.c),
+// with a model of the LPC824 I2C master and two slaves.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "test.h"
+#include "i2c_fsm.h"
+
+#define SENSOR_ADDR 0x48U   // Register pointer, then registers.
+#define EEPROM_ADDR 0x50U   // Accepts the first byte only, NACKs the others.
+#define MODEL_IDLE 0xFFU    // Interrupt disabled: the queue is empty.
+
+// Bus model.
+static uint8_t regs[256];
+static uint8_t regPtr;
+static bool firstByte;
+static bool reading;
+static uint8_t slave;
+static uint32_t mstState;
+static uint8_t mstData;
+static uint32_t now;
+
+static i2c_fsm_t fsm;
+
+// Order in which the transactions finished.
+static i2c_xfer_t *finished[16];
+static uint32_t numFinished;
+static i2c_xfer_t *resubmit;
+
+
+static void done(i2c_xfer_t *xfer) {
+  finished[numFinished++] = xfer;
+  if ((xfer == resubmit) && (numFinished < 3U)) {
+    CHECK(i2c_fsm_submit(&fsm, resubmit));   // From the callback.
+  }
+}
+
+
+// What the master does with a command; sets the next MSTSTATE.
+static void master(i2c_cmd_t cmd) {
+
+  if ((cmd.flags & I2C_CMD_IDLE) != 0U) {
+    mstState = MODEL_IDLE;
+  } else if ((cmd.flags & I2C_CMD_START) != 0U) {
+    slave = cmd.data >> 1;
+    reading = (cmd.data & 1U) != 0U;
+    firstByte = true;
+    if ((slave != SENSOR_ADDR) && (slave != EEPROM_ADDR)) {
+      mstState = I2C_MST_NACK_ADDR;
+    } else if (reading) {
+      mstData = regs[regPtr++];
+      mstState = I2C_MST_RX_READY;
+    } else {
+      mstState = I2C_MST_TX_READY;
+    }
+  } else if ((cmd.flags & I2C_CMD_STOP) != 0U) {
+    mstState = I2C_MST_IDLE;
+  } else if ((cmd.flags & I2C_CMD_CONTINUE) != 0U) {
+    if (reading) {
+      mstData = regs[regPtr++];
+      mstState = I2C_MST_RX_READY;
+    } else if ((slave == EEPROM_ADDR) && !firstByte) {
+      mstState = I2C_MST_NACK_DATA;
+    } else {
+      if (firstByte) {
+	regPtr = cmd.data;
+	firstByte = false;
+      } else {
+	regs[regPtr++] = cmd.data;
+      }
+      mstState = I2C_MST_TX_READY;
+    }
+  }
+}
+
+
+// Interrupts until the queue is empty.
+static void run(void) {
+
+  uint32_t steps = 0;
+
+  mstState = I2C_MST_IDLE;
+  while ((mstState != MODEL_IDLE) && (steps++ < 1000U)) {
+    master(i2c_fsm_event(&fsm, mstState, mstData, 0, ++now));
+  }
+  CHECK(mstState == MODEL_IDLE);
+}
+
+
+int main(void) {
+
+  uint8_t writeData[3] = { 0x10, 0xAA, 0xBB };
+  uint8_t regNum = 0x10;
+  uint8_t rx2[2];
+  uint8_t rx4[4];
+  uint32_t i;
+  i2c_cmd_t cmd;
+
+  i2c_xfer_t write = { .addr = SENSOR_ADDR, .txLen = 3, .tx = writeData,
+		       .done = done };
+  i2c_xfer_t combined = { .addr = SENSOR_ADDR, .txLen = 1, .tx = &regNum,
+			  .rxLen = 2, .rx = rx2, .done = done };
+  i2c_xfer_t noSlave = { .addr = 0x22, .txLen = 1, .tx = &regNum,
+			 .done = done };
+  i2c_xfer_t nackData = { .addr = EEPROM_ADDR, .txLen = 3, .tx = writeData,
+			  .done = done };
+  i2c_xfer_t read = { .addr = SENSOR_ADDR, .rxLen = 4, .rx = rx4,
+		      .done = done };
+  i2c_xfer_t empty = { .addr = SENSOR_ADDR };
+
+  for (i = 0; i < 256U; i++) {
+    regs[i] = (uint8_t)(i ^ 0x5AU);
+  }
+  i2c_fsm_init(&fsm);
+
+  // Submit: once per transaction while it is pending; not empty ones.
+  CHECK(i2c_fsm_submit(&fsm, &write));
+  CHECK(!i2c_fsm_submit(&fsm, &write));
+  CHECK(!i2c_fsm_submit(&fsm, &empty));
+  CHECK(i2c_fsm_submit(&fsm, &combined));
+  CHECK(i2c_fsm_submit(&fsm, &noSlave));
+  CHECK(i2c_fsm_submit(&fsm, &nackData));
+  CHECK(i2c_fsm_submit(&fsm, &read));
+  CHECK_EQ(read.status, kI2cXfer_Pending);
+
+  // Queue order, data, and NACK of the address and of a data byte.
+  run();
+  CHECK_EQ(numFinished, 5);
+  CHECK(finished[0] == &write);
+  CHECK(finished[1] == &combined);
+  CHECK(finished[2] == &noSlave);
+  CHECK(finished[3] == &nackData);
+  CHECK(finished[4] == &read);
+  CHECK_EQ(write.status, kI2cXfer_Done);
+  CHECK_EQ(combined.status, kI2cXfer_Done);
+  CHECK_EQ(rx2[0], 0xAA);
+  CHECK_EQ(rx2[1], 0xBB);
+  CHECK_EQ(noSlave.status, kI2cXfer_NackAddr);
+  CHECK_EQ(nackData.status, kI2cXfer_NackData);
+  CHECK_EQ(read.status, kI2cXfer_Done);
+  CHECK_EQ(rx4[0], 0xAA);   // The pointer was left at 0x10 by 'combined'.
+  CHECK_EQ(rx4[1], 0xBB);
+  CHECK_EQ(rx4[2], 0x12U ^ 0x5AU);
+  CHECK_EQ(fsm.stats.done, 3);
+  CHECK_EQ(fsm.stats.nackAddr, 1);
+  CHECK_EQ(fsm.stats.nackData, 1);
+  CHECK(fsm.head == NULL);
+  CHECK(fsm.stats.busyTime > 0U);
+
+  // Submitted again from its own callback: runs after the others.
+  numFinished = 0;
+  resubmit = &combined;
+  CHECK(i2c_fsm_submit(&fsm, &combined));
+  CHECK(i2c_fsm_submit(&fsm, &write));
+  run();
+  resubmit = NULL;
+  CHECK_EQ(numFinished, 3);
+  CHECK(finished[0] == &combined);
+  CHECK(finished[1] == &write);
+  CHECK(finished[2] == &combined);
+
+  // Timeout: the slave never answers after the START.
+  numFinished = 0;
+  CHECK(i2c_fsm_submit(&fsm, &read));
+  CHECK(i2c_fsm_submit(&fsm, &write));
+  cmd = i2c_fsm_event(&fsm, I2C_MST_IDLE, 0, 0, 100);
+  CHECK((cmd.flags & I2C_CMD_START) != 0U);
+  CHECK(!i2c_fsm_check_timeout(&fsm, 200, 100));
+  CHECK(i2c_fsm_check_timeout(&fsm, 201, 100));
+  CHECK_EQ(read.status, kI2cXfer_Timeout);
+  CHECK_EQ(fsm.stats.timeouts, 1);
+  CHECK(!fsm.active);
+  CHECK(!i2c_fsm_check_timeout(&fsm, 1000, 100));   // Nothing on the bus.
+  // After the master reset the next one of the queue runs.
+  now = 1000;
+  run();
+  CHECK_EQ(numFinished, 2);
+  CHECK(finished[1] == &write);
+  CHECK_EQ(write.status, kI2cXfer_Done);
+
+  // Arbitration lost.
+  CHECK(i2c_fsm_submit(&fsm, &write));
+  cmd = i2c_fsm_event(&fsm, I2C_MST_IDLE, 0, 0, 2000);
+  cmd = i2c_fsm_event(&fsm, I2C_MST_IDLE, 0, I2C_EVENT_ARB_LOSS, 2010);
+  CHECK_EQ(write.status, kI2cXfer_ArbLost);
+  CHECK_EQ(fsm.stats.arbLost, 1);
+  CHECK_EQ(cmd.flags, 0);   // Master idle; the queue is empty after that.
+  cmd = i2c_fsm_event(&fsm, I2C_MST_IDLE, 0, 0, 2020);
+  CHECK_EQ(cmd.flags, I2C_CMD_IDLE);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,222 @@
+// Host test of the key/value store (kv_store.c) with a RAM model of the
+// flash, including writes cut by a power failure.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "test.h"
+#include "kv_store.h"
+
+#define SECTOR_SIZE 1024U
+#define NUM_SECTORS 2U
+#define PAGES_PER_SECTOR (SECTOR_SIZE / KV_PAGE_SIZE)
+#define NO_FAILURE 0xFFFFFFFFU
+
+// Flash model: erase sets 0xFF, programming can only clear bits.
+static uint32_t mem[NUM_SECTORS * SECTOR_SIZE / 4U];
+static uint32_t programs;       // Page writes so far.
+static uint32_t failAtProgram;  // This write is cut by a power failure...
+static uint32_t tornBytes;      // ...after this many bytes.
+static uint32_t erases;
+
+static status_t ram_erase(uint32_t sector) {
+  memset((uint8_t *)mem + (sector * SECTOR_SIZE), 0xFF, SECTOR_SIZE);
+  erases++;
+  return kStatus_Success;
+}
+
+static status_t ram_program(uint32_t offset, const uint32_t *data) {
+
+  uint8_t *dst = (uint8_t *)mem + offset;
+  const uint8_t *src = (const uint8_t *)data;
+  uint32_t len = KV_PAGE_SIZE;
+  uint32_t i;
+
+  CHECK_EQ(offset % KV_PAGE_SIZE, 0);
+  if (programs++ == failAtProgram) {
+    len = tornBytes;
+  }
+  for (i = 0; i < len; i++) {
+    dst[i] &= src[i];
+  }
+  return (len == KV_PAGE_SIZE) ? kStatus_Success : kStatus_Fail;
+}
+
+static const kv_flash_t ramFlash = {
+  .mem = (const uint8_t *)mem,
+  .sectorSize = SECTOR_SIZE,
+  .numSectors = NUM_SECTORS,
+  .erase = ram_erase,
+  .program = ram_program,
+};
+
+
+// The next page write fails after 'bytes' bytes.
+static void power_fail_at_next_write(uint32_t bytes) {
+  failAtProgram = programs;
+  tornBytes = bytes;
+}
+
+// Reset: the store is found again in the flash.
+static void reboot(void) {
+  failAtProgram = NO_FAILURE;
+  CHECK_EQ(kv_init(&ramFlash), kStatus_Success);
+}
+
+static uint32_t get_u32(uint8_t key) {
+  uint32_t value = 0;
+  CHECK_EQ(kv_get(key, &value, sizeof(value)), sizeof(value));
+  return value;
+}
+
+// Page 0 of a sector starts with "KVST" when its header was written.
+static bool header_written(uint32_t sector) {
+  return mem[sector * SECTOR_SIZE / 4U] == 0x5453564BU;
+}
+
+// The last page of the sector is used: the next put compacts.
+static bool sector_full(uint32_t sector) {
+  return mem[((sector + 1U) * SECTOR_SIZE - KV_PAGE_SIZE) / 4U] != 0xFFFFFFFFU;
+}
+
+// Same CRC-32 as kv_store.c, for writing headers by hand.
+static uint32_t crc32(const void *data, uint32_t len) {
+
+  const uint8_t *p = data;
+  uint32_t crc = 0xFFFFFFFFU;
+  uint32_t bit;
+
+  while (len--) {
+    crc ^= *p++;
+    for (bit = 0; bit < 8U; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+  }
+  return ~crc;
+}
+
+static void set_generation(uint32_t sector, uint32_t generation) {
+  uint32_t *header = &mem[sector * SECTOR_SIZE / 4U];
+  header[1] = generation;
+  header[2] = crc32(header, 2U * sizeof(uint32_t));
+}
+
+
+int main(void) {
+
+  uint32_t value;
+  uint8_t big[KV_MAX_VALUE_LEN];
+  uint8_t out[KV_MAX_VALUE_LEN];
+  uint32_t i;
+  uint32_t before;
+
+  memset(mem, 0x00, sizeof(mem));   // Not erased: no valid sector.
+  failAtProgram = NO_FAILURE;
+
+  // First start: formatted.
+  CHECK_EQ(kv_init(&ramFlash), kStatus_Success);
+  CHECK(header_written(0));
+  CHECK_EQ(kv_get(0, &value, sizeof(value)), -1);
+
+  // Put, get, delete; invalid arguments.
+  value = 1234;
+  CHECK_EQ(kv_put(1, &value, sizeof(value)), kStatus_Success);
+  CHECK_EQ(get_u32(1), 1234);
+  for (i = 0; i < sizeof(big); i++) {
+    big[i] = (uint8_t)(i * 7U);
+  }
+  CHECK_EQ(kv_put(2, big, sizeof(big)), kStatus_Success);
+  CHECK_EQ(kv_get(2, out, sizeof(out)), KV_MAX_VALUE_LEN);
+  CHECK(memcmp(out, big, sizeof(big)) == 0);
+  CHECK_EQ(kv_put(KV_MAX_KEYS, &value, sizeof(value)), kStatus_InvalidArgument);
+  CHECK_EQ(kv_put(1, big, KV_MAX_VALUE_LEN + 1U), kStatus_InvalidArgument);
+  CHECK_EQ(kv_put(1, &value, 0), kStatus_InvalidArgument);
+  CHECK_EQ(kv_put(3, &value, sizeof(value)), kStatus_Success);
+  CHECK_EQ(kv_delete(3), kStatus_Success);
+  CHECK_EQ(kv_get(3, &value, sizeof(value)), -1);
+  reboot();
+  CHECK_EQ(get_u32(1), 1234);
+  CHECK_EQ(kv_get(3, &value, sizeof(value)), -1);
+
+  // Overwrite; the same value again writes nothing.
+  value = 5678;
+  CHECK_EQ(kv_put(1, &value, sizeof(value)), kStatus_Success);
+  before = programs;
+  CHECK_EQ(kv_put(1, &value, sizeof(value)), kStatus_Success);
+  CHECK_EQ(programs, before);
+  reboot();
+  CHECK_EQ(get_u32(1), 5678);
+
+  // Torn record page: the previous value stays.
+  value = 9999;
+  power_fail_at_next_write(KV_PAGE_SIZE / 2U);
+  CHECK(kv_put(1, &value, sizeof(value)) != kStatus_Success);
+  reboot();
+  CHECK_EQ(get_u32(1), 5678);
+  value = 4321;   // The torn page is skipped, the next one is used.
+  CHECK_EQ(kv_put(1, &value, sizeof(value)), kStatus_Success);
+  reboot();
+  CHECK_EQ(get_u32(1), 4321);
+
+  // Fill the sector: the next put compacts into sector 1.
+  before = erases;
+  for (i = 0; !header_written(1) && (i < PAGES_PER_SECTOR); i++) {
+    value = 100U + i;
+    CHECK_EQ(kv_put(4, &value, sizeof(value)), kStatus_Success);
+  }
+  CHECK(header_written(1));
+  CHECK_EQ(erases, before + 1U);
+  CHECK_EQ(kv_erase_count(), 1);
+  CHECK_EQ(get_u32(4), 100U + i - 1U);
+  CHECK_EQ(get_u32(1), 4321);
+  CHECK_EQ(kv_get(2, out, sizeof(out)), KV_MAX_VALUE_LEN);
+  CHECK(memcmp(out, big, sizeof(big)) == 0);
+  CHECK_EQ(kv_get(3, &value, sizeof(value)), -1);   // Deleted: not copied.
+
+  // Both headers are valid now; the newer generation (sector 1) is used.
+  // Sector 0 still holds an older value of key 4.
+  reboot();
+  CHECK_EQ(get_u32(4), 100U + i - 1U);
+
+  // Also across the wrap of the generation counter.
+  set_generation(0, 0xFFFFFFFFU);
+  set_generation(1, 0U);
+  reboot();
+  CHECK_EQ(get_u32(4), 100U + i - 1U);
+  set_generation(0, 2U);
+  set_generation(1, 1U);
+  reboot();
+  CHECK(get_u32(4) != 100U + i - 1U);   // Sector 0 with its old value.
+  set_generation(0, 1U);
+  set_generation(1, 2U);
+  reboot();
+
+  // Torn header during compaction: sector 1 stays active.
+  reboot();
+  value = 1;
+  while (!sector_full(1)) {
+    CHECK_EQ(kv_put(4, &value, sizeof(value)), kStatus_Success);
+    value++;
+  }
+  // The next put erases sector 0, copies the 3 keys (1, 2, 4) and writes
+  // the header; the power fails after its magic and generation.
+  before = erases;
+  failAtProgram = programs + 3U;
+  tornBytes = 8;
+  CHECK(kv_put(4, &value, sizeof(value)) != kStatus_Success);
+  CHECK_EQ(erases, before + 1U);
+  CHECK(header_written(0));
+  reboot();
+  CHECK_EQ(get_u32(4), value - 1U);   // Sector 1, the last good value.
+  CHECK_EQ(get_u32(1), 4321);
+  // The next put compacts again, this time completely.
+  CHECK_EQ(kv_put(4, &value, sizeof(value)), kStatus_Success);
+  reboot();
+  CHECK(!sector_full(0));
+  CHECK_EQ(get_u32(4), value);
+  CHECK_EQ(get_u32(1), 4321);
+  CHECK_EQ(kv_get(2, out, sizeof(out)), KV_MAX_VALUE_LEN);
+  CHECK(memcmp(out, big, sizeof(big)) == 0);
+
+  return TEST_RESULT();
+}
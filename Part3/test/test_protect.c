@@ -0,0 +1,80 @@
+// Host test of the trip, restart and latch decisions of protect_fsm.c.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "test.h"
+#include "protect_fsm.h"
+
+static protect_fsm_t fsm;
+
+// A short overvoltage at 'ms': trip, and below the threshold 1 ms later.
+static void pulse(uint32_t ms) {
+  protect_fsm_edge(&fsm, true, ms);
+  protect_fsm_edge(&fsm, false, ms + 1U);
+}
+
+
+int main(void) {
+
+  uint32_t t;
+
+  protect_fsm_init(&fsm);
+  CHECK_EQ(fsm.stats.state, kProtect_Running);
+  CHECK(!protect_fsm_poll(&fsm, 10000));
+
+  // Trip: the PWM stays off while the voltage is high.
+  t = 10000;
+  protect_fsm_edge(&fsm, true, t);
+  CHECK_EQ(fsm.stats.state, kProtect_Tripped);
+  CHECK_EQ(fsm.stats.trips, 1);
+  CHECK_EQ(fsm.stats.lastTripMs, t);
+  CHECK(!protect_fsm_poll(&fsm, t + 1000U));
+
+  // Below the threshold: restart after the hold off time, once.
+  protect_fsm_edge(&fsm, false, t + 10U);
+  CHECK_EQ(fsm.stats.state, kProtect_Holdoff);
+  CHECK(!protect_fsm_poll(&fsm, t + 10U + PROTECT_HOLDOFF_MS - 1U));
+  CHECK(protect_fsm_poll(&fsm, t + 10U + PROTECT_HOLDOFF_MS));
+  CHECK_EQ(fsm.stats.state, kProtect_Running);
+  CHECK_EQ(fsm.stats.rearms, 1);
+  CHECK(!protect_fsm_poll(&fsm, t + 10U + PROTECT_HOLDOFF_MS));
+
+  // PROTECT_MAX_RETRIES trips in the window: latched on the last one.
+  pulse(t + 500U);
+  CHECK_EQ(fsm.stats.state, kProtect_Holdoff);
+  CHECK(protect_fsm_poll(&fsm, t + 1000U));
+  pulse(t + 1500U);
+  CHECK_EQ(fsm.stats.trips, PROTECT_MAX_RETRIES);
+  CHECK_EQ(fsm.stats.state, kProtect_Latched);
+  CHECK(!protect_fsm_poll(&fsm, t + 3000U));
+
+  // Latched: stays off, also after the retry window.
+  pulse(t + PROTECT_RETRY_WINDOW_MS + 2000U);
+  CHECK_EQ(fsm.stats.state, kProtect_Latched);
+  CHECK(!protect_fsm_poll(&fsm, t + PROTECT_RETRY_WINDOW_MS + 3000U));
+
+  // Manual rearm restarts it, and the trips are counted from 0 again.
+  CHECK(protect_fsm_rearm(&fsm));
+  CHECK_EQ(fsm.stats.state, kProtect_Running);
+  CHECK(!protect_fsm_rearm(&fsm));   // Already running.
+  t += PROTECT_RETRY_WINDOW_MS + 4000U;
+  pulse(t);
+  CHECK_EQ(fsm.stats.state, kProtect_Holdoff);
+
+  // Trips further apart than the window never latch.
+  protect_fsm_init(&fsm);
+  for (t = 20000; t < 20000U + 10U * (PROTECT_RETRY_WINDOW_MS + 1U);
+       t += PROTECT_RETRY_WINDOW_MS + 1U) {
+    pulse(t);
+    CHECK_EQ(fsm.stats.state, kProtect_Holdoff);
+    CHECK(protect_fsm_poll(&fsm, t + 1U + PROTECT_HOLDOFF_MS));
+  }
+
+  // The hold off time across the wrap of the ms counter.
+  protect_fsm_init(&fsm);
+  pulse(0xFFFFFFF0U);
+  CHECK(!protect_fsm_poll(&fsm, 0xFFFFFFFFU));
+  CHECK(protect_fsm_poll(&fsm, 0xFFFFFFF1U + PROTECT_HOLDOFF_MS));
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,120 @@
+// Host test of spectral.c against a double precision DFT.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "test.h"
+#include "spectral.h"
+
+#define FFT_MAX_ERROR 5.0        // LSB of Q15, |X - Xref| of any bin.
+#define GOERTZEL_OWN_ERROR 1.0   // LSB of |X|, tone in the bin itself.
+#define GOERTZEL_OTHER_ERROR 1.0 // LSB of |X|, all other bins.
+
+static double refRe[SPECTRAL_MAX_N];
+static double refIm[SPECTRAL_MAX_N];
+
+// DFT(x) / n, the scale of spectral_fft().
+static void dft(const int16_t *x, uint32_t n) {
+
+  uint32_t k, i;
+
+  for (k = 0; k < n; k++) {
+    refRe[k] = 0.0;
+    refIm[k] = 0.0;
+    for (i = 0; i < n; i++) {
+      refRe[k] += x[i] * cos(2.0 * M_PI * k * i / n);
+      refIm[k] -= x[i] * sin(2.0 * M_PI * k * i / n);
+    }
+    refRe[k] /= n;
+    refIm[k] /= n;
+  }
+}
+
+
+static double fft_error(const int16_t *x, uint32_t n) {
+
+  int16_t re[SPECTRAL_MAX_N];
+  int16_t im[SPECTRAL_MAX_N];
+  double error = 0.0;
+  uint32_t k;
+
+  for (k = 0; k < n; k++) {
+    re[k] = x[k];
+  }
+  CHECK(spectral_fft(re, im, n));
+  dft(x, n);
+  for (k = 0; k < n; k++) {
+    error = fmax(error, hypot(re[k] - refRe[k], im[k] - refIm[k]));
+  }
+  return error;
+}
+
+
+static void full_scale_sine(int16_t *x, uint32_t n, uint32_t k, double phase) {
+
+  uint32_t i;
+
+  for (i = 0; i < n; i++) {
+    x[i] = (int16_t)lrint(32767.0 * sin(2.0 * M_PI * k * i / n + phase));
+  }
+}
+
+
+int main(void) {
+
+  static const uint32_t sizes[] = { 64, 128, 256 };
+  int16_t x[SPECTRAL_MAX_N];
+  int16_t re[SPECTRAL_MAX_N];
+  int16_t im[SPECTRAL_MAX_N];
+  uint32_t seed = 1;
+  uint32_t s, k, b, i, trial;
+  double fftError, ownError, otherError, error;
+
+  CHECK(!spectral_fft(re, im, 32));
+  CHECK_EQ(spectral_goertzel(x, 100, 3), 0);
+
+  for (s = 0; s < 3; s++) {
+    uint32_t n = sizes[s];
+
+    fftError = 0.0;
+    ownError = 0.0;
+    otherError = 0.0;
+    for (k = 1; k < (n / 2U); k++) {
+      full_scale_sine(x, n, k, 0.1 * k);
+      fftError = fmax(fftError, fft_error(x, n));
+
+      // Same block: FFT peak and Goertzel of every bin.
+      for (i = 0; i < n; i++) {
+	re[i] = x[i];
+      }
+      spectral_fft(re, im, n);
+      CHECK_EQ(spectral_peak_bin(re, im, n), k);
+      for (b = 1; b < (n / 2U); b++) {
+	error = fabs(sqrt((double)spectral_goertzel(x, n, b)) -
+		     hypot(refRe[b], refIm[b]));
+	if (b == k) {
+	  ownError = fmax(ownError, error);
+	} else {
+	  otherError = fmax(otherError, error);
+	}
+      }
+    }
+
+    // Full scale noise (a simple LCG, the same on every run).
+    for (trial = 0; trial < 50; trial++) {
+      for (i = 0; i < n; i++) {
+	seed = seed * 1103515245U + 12345U;
+	x[i] = (int16_t)(seed >> 16);
+      }
+      fftError = fmax(fftError, fft_error(x, n));
+    }
+
+    printf("n = %3u: FFT %.2f, Goertzel %.2f (own bin) %.2f (others) LSB\n",
+	   n, fftError, ownError, otherError);
+    CHECK(fftError <= FFT_MAX_ERROR);
+    CHECK(ownError <= GOERTZEL_OWN_ERROR);
+    CHECK(otherError <= GOERTZEL_OTHER_ERROR);
+  }
+
+  return TEST_RESULT();
+}
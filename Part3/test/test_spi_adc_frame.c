@@ -0,0 +1,142 @@
+// Host test of the SPI ADC frame format and block ring (spi_adc_frame.c),
+// with a model of an SPI ADC and of the DMA that fills the blocks.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "test.h"
+#include "spi_adc_frame.h"
+
+// Model of the ADC: the frame for one result. The bits before and after
+// the result are not defined by the ADC; here they are set to 1.
+static uint16_t adc_frame(const spi_adc_format_t *format, uint16_t result) {
+
+  uint32_t frameMask = (1U << format->frameBits) - 1U;
+  uint32_t dataMask = ((1U << format->dataBits) - 1U) << format->dataShift;
+
+  return (uint16_t)((frameMask & ~dataMask) |
+		    (((uint32_t)result << format->dataShift) & dataMask));
+}
+
+// Model of the DMA: fills 'block' with frames and tells the ring.
+static uint16_t blocks[SPI_ADC_NUM_BLOCKS][SPI_ADC_BLOCK_LEN];
+static uint32_t nextResult;
+
+static void dma_fill(spi_adc_ring_t *ring, const spi_adc_format_t *format,
+		     uint32_t block) {
+
+  uint32_t i;
+
+  for (i = 0; i < SPI_ADC_BLOCK_LEN; i++) {
+    blocks[block][i] =
+      adc_frame(format, (uint16_t)(nextResult++ & ((1U << format->dataBits) - 1U)));
+  }
+  spi_adc_ring_complete(ring, block);
+}
+
+// The first result of a block, as the main loop sees it.
+static uint32_t first_result(const spi_adc_format_t *format, int32_t block) {
+  return spi_adc_decode(format, blocks[block][0]);
+}
+
+
+int main(void) {
+
+  static const spi_adc_format_t formats[] = {
+    { 16, 12, 0 },   // 12 bit ADC, 4 leading bits.
+    { 16, 12, 2 },   // 12 bit, 2 leading and 2 trailing bits.
+    { 14, 14, 0 },   // 14 bit, nothing else.
+    { 16, 16, 0 },
+    { 8,  8,  0 },
+    { 1,  1,  0 },
+  };
+  static const spi_adc_format_t invalid[] = {
+    { 0,  0,  0 },
+    { 17, 12, 0 },   // Longer than an SPI frame.
+    { 16, 0,  0 },   // No result.
+    { 16, 12, 5 },   // Result does not fit into the frame.
+    { 12, 13, 0 },
+  };
+  const spi_adc_format_t *format;
+  spi_adc_ring_t ring;
+  uint32_t word;
+  uint32_t f, v, ssel, b;
+  int32_t block;
+
+  // Formats and decoding.
+  for (f = 0; f < (sizeof(formats) / sizeof(formats[0])); f++) {
+    format = &formats[f];
+    CHECK(spi_adc_format_valid(format));
+    for (v = 0; v < (1U << format->dataBits); v += 1U + (v / 7U)) {
+      CHECK_EQ(spi_adc_decode(format, adc_frame(format, (uint16_t)v)), v);
+    }
+    v = (1U << format->dataBits) - 1U;
+    CHECK_EQ(spi_adc_decode(format, adc_frame(format, (uint16_t)v)), v);
+
+    // LEN = frame bits - 1, EOT, only SSELn asserted (low), data 0.
+    // See: 18.6.7 SPI Transmitter Data and Control register.
+    for (ssel = 0; ssel < 4U; ssel++) {
+      word = spi_adc_txdatctl(format, ssel);
+      CHECK_EQ((word >> 24) & 0xFU, format->frameBits - 1U);
+      CHECK((word & (1U << 20)) != 0U);
+      CHECK_EQ((word >> 16) & 0xFU, 0xFU & ~(1U << ssel));
+      CHECK_EQ(word & 0xFFFFU, 0U);
+      CHECK_EQ(word & 0xF0E00000U, 0U);
+    }
+  }
+  for (f = 0; f < (sizeof(invalid) / sizeof(invalid[0])); f++) {
+    CHECK(!spi_adc_format_valid(&invalid[f]));
+  }
+
+  // Blocks are read in the order they were filled. The main loop reads
+  // two blocks after every second one.
+  format = &formats[0];
+  spi_adc_ring_reset(&ring);
+  CHECK_EQ(spi_adc_ring_get(&ring), -1);
+  nextResult = 0;
+  for (b = 0; b < 3U * SPI_ADC_NUM_BLOCKS; b++) {
+    dma_fill(&ring, format, b % SPI_ADC_NUM_BLOCKS);
+    if ((b % 2U) == 1U) {
+      block = spi_adc_ring_get(&ring);
+      CHECK_EQ(block, (int32_t)((b - 1U) % SPI_ADC_NUM_BLOCKS));
+      CHECK_EQ(first_result(format, block), (b - 1U) * SPI_ADC_BLOCK_LEN);
+      CHECK_EQ(spi_adc_ring_get(&ring), block);   // Until it is released.
+      spi_adc_ring_release(&ring, (uint32_t)block);
+      block = spi_adc_ring_get(&ring);
+      CHECK_EQ(block, (int32_t)(b % SPI_ADC_NUM_BLOCKS));
+      CHECK_EQ(first_result(format, block), b * SPI_ADC_BLOCK_LEN);
+      spi_adc_ring_release(&ring, (uint32_t)block);
+    }
+  }
+  CHECK_EQ(spi_adc_ring_get(&ring), -1);
+  CHECK_EQ(ring.overruns, 0U);
+
+  // The main loop falls behind: when the DMA starts writing a full block,
+  // that block is dropped, and the oldest block left is read next.
+  spi_adc_ring_reset(&ring);
+  nextResult = 0;
+  for (b = 0; b < SPI_ADC_NUM_BLOCKS - 1U; b++) {
+    dma_fill(&ring, format, b);
+  }
+  CHECK_EQ(ring.overruns, 0U);
+  dma_fill(&ring, format, SPI_ADC_NUM_BLOCKS - 1U);  // DMA now in block 0.
+  CHECK_EQ(ring.overruns, 1U);
+  block = spi_adc_ring_get(&ring);
+  CHECK_EQ(block, 1);
+  CHECK_EQ(first_result(format, block), SPI_ADC_BLOCK_LEN);
+  spi_adc_ring_release(&ring, (uint32_t)block);
+  dma_fill(&ring, format, 0);                        // DMA now in block 1.
+  CHECK_EQ(ring.overruns, 1U);                       // It was released.
+  dma_fill(&ring, format, 1);                        // DMA now in block 2.
+  CHECK_EQ(ring.overruns, 2U);
+  block = spi_adc_ring_get(&ring);
+  CHECK_EQ(block, 3);
+  CHECK_EQ(first_result(format, block), 3U * SPI_ADC_BLOCK_LEN);
+  spi_adc_ring_release(&ring, (uint32_t)block);
+  CHECK_EQ(spi_adc_ring_get(&ring), 0);
+  spi_adc_ring_release(&ring, 0);
+  CHECK_EQ(spi_adc_ring_get(&ring), 1);
+  spi_adc_ring_release(&ring, 1);
+  CHECK_EQ(spi_adc_ring_get(&ring), -1);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,53 @@
+// Host test of the cycle count of timebase.h across a SysTick reload.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "test.h"
+#include "timebase.h"
+
+#define CYCLES_PER_MS 30000U   // 30 MHz core clock
+
+// SysTick model: 'now' cycles after the start. The interrupt counted the
+// milliseconds only up to 'countedMs' (it is pending, or has not run).
+static uint32_t read_cycles(uint32_t now, uint32_t countedMs) {
+
+  uint32_t ms = now / CYCLES_PER_MS;
+  uint32_t val = CYCLES_PER_MS - 1U - (now % CYCLES_PER_MS);
+
+  return timebase_cycles_from(countedMs, val, ms != countedMs, CYCLES_PER_MS);
+}
+
+
+int main(void) {
+
+  uint32_t start;
+  uint32_t end;
+
+  // Interrupt not pending: the plain count.
+  CHECK_EQ(timebase_cycles_from(0, CYCLES_PER_MS - 1U, false, CYCLES_PER_MS), 0);
+  CHECK_EQ(timebase_cycles_from(5, 0, false, CYCLES_PER_MS),
+	   6U * CYCLES_PER_MS - 1U);
+
+  // An ISR of the SysTick level starts 100 cycles before the reload and
+  // ends 100 cycles after it; the SysTick interrupt waits.
+  start = read_cycles(7U * CYCLES_PER_MS - 100U, 6);
+  end = read_cycles(7U * CYCLES_PER_MS + 100U, 6);
+  CHECK_EQ(end - start, 200);
+
+  // The same after the interrupt counted the millisecond.
+  end = read_cycles(7U * CYCLES_PER_MS + 100U, 7);
+  CHECK_EQ(end - start, 200);
+
+  // Reload exactly at the end of the interval.
+  end = read_cycles(7U * CYCLES_PER_MS, 6);
+  CHECK_EQ(end - start, 100);
+
+  // Across the 32 bit wrap of the cycle count.
+  start = read_cycles(0xFFFFFFFFU / CYCLES_PER_MS * CYCLES_PER_MS - 10U,
+		      0xFFFFFFFFU / CYCLES_PER_MS - 1U);
+  end = read_cycles(0xFFFFFFFFU / CYCLES_PER_MS * CYCLES_PER_MS + 10U,
+		    0xFFFFFFFFU / CYCLES_PER_MS - 1U);
+  CHECK_EQ(end - start, 20);
+
+  return TEST_RESULT();
+}
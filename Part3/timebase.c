@@ -0,0 +1,90 @@
+// Free running time base from the SysTick timer. See timebase.h.
+
+#include "fsl_device_registers.h"
+#include "timebase.h"
+
+static volatile uint32_t msTicks;   // Incremented by SysTick_Handler.
+static uint32_t cyclesPerMs;
+
+static timebase_tick_t tickFuncs[TIMEBASE_MAX_TICK_FUNCS];
+static volatile uint8_t numTickFuncs;
+
+
+void timebase_init(uint32_t coreClock_Hz) {
+
+  cyclesPerMs = coreClock_Hz / 1000U;
+  msTicks = 0;
+
+  // See: ARM Cortex-M0+ Devices Generic User Guide, 4.4 System timer.
+  SysTick->LOAD = cyclesPerMs - 1U;  // Counts cyclesPerMs-1 down to 0.
+  SysTick->VAL = 0;
+  SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | // Core clock
+		  SysTick_CTRL_TICKINT_Msk |   // Interrupt at 0
+		  SysTick_CTRL_ENABLE_Msk;
+}
+
+
+bool timebase_add_tick(timebase_tick_t tick) {
+
+  uint32_t primask;
+  bool ok = false;
+
+  primask = DisableGlobalIRQ();
+  if (numTickFuncs < TIMEBASE_MAX_TICK_FUNCS) {
+    tickFuncs[numTickFuncs] = tick;
+    numTickFuncs++;   // After the entry is written: SysTick may read it.
+    ok = true;
+  }
+  EnableGlobalIRQ(primask);
+  return ok;
+}
+
+
+uint32_t timebase_ms(void) {
+  return msTicks;
+}
+
+
+uint32_t timebase_cycles(void) {
+
+  uint32_t ms;
+  uint32_t val;
+  bool wrapPending;
+
+  // If the millisecond changes while reading, read again.
+  // The SysTick interrupt may also be pending and not able to run: the
+  // caller disabled the interrupts, or it is an ISR of the SysTick level.
+  // Then SysTick was reloaded but the millisecond is not counted yet; without
+  // adding it, the time would go back by 1 ms (and an interval measured
+  // across the reload would underflow to about 2^32 cycles).
+  // See: ARM Cortex-M0+ Devices Generic User Guide, 4.3.3 ICSR.
+  do {
+    ms = msTicks;
+    val = SysTick->VAL;
+    wrapPending = ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0U);
+    if (wrapPending) {
+      // The value read before the flag may be from before the reload:
+      val = SysTick->VAL;
+    }
+  } while (ms != msTicks);
+
+  return timebase_cycles_from(ms, val, wrapPending, cyclesPerMs);
+}
+
+
+uint32_t timebase_cycles_per_us(void) {
+  return cyclesPerMs / 1000U;
+}
+
+
+// SysTick interrupt, every millisecond.
+// It was declared as a weak function in the file startup_LPC824.S.
+void SysTick_Handler(void) {
+
+  uint32_t i;
+
+  msTicks++;
+  for (i = 0; i < numTickFuncs; i++) {
+    tickFuncs[i]();
+  }
+}
@@ -0,0 +1,49 @@
+// Free running time base from the SysTick timer.
+//
+// SysTick counts down at the core clock and interrupts every millisecond.
+// timebase_cycles() combines the millisecond count and the SysTick value
+// into a 32 bit cycle counter (Cortex-M0+ has no DWT cycle counter).
+// It wraps around after 2^32 cycles (143 s at 30 MHz); the difference of
+// two readings is correct as long as it is shorter than that.
+//
+// Other modules can have a function called by the SysTick interrupt every
+// millisecond (timebase_add_tick()). It runs at the highest priority
+// (irq_prio.h), so it must be very short: set a flag, pend an interrupt.
+
+#ifndef _TIMEBASE_H_
+#define _TIMEBASE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIMEBASE_MAX_TICK_FUNCS 4U
+
+typedef void (*timebase_tick_t)(void);
+
+// coreClock_Hz must be a multiple of 1000.
+void timebase_init(uint32_t coreClock_Hz);
+
+// Call 'tick' from the SysTick interrupt every millisecond. Returns false
+// if the table is full.
+bool timebase_add_tick(timebase_tick_t tick);
+
+uint32_t timebase_ms(void);
+uint32_t timebase_cycles(void);
+
+// Cycles per microsecond, for converting cycle differences.
+uint32_t timebase_cycles_per_us(void);
+
+// The cycle count of timebase_cycles() from the millisecond count, the
+// SysTick value, and whether SysTick reached 0 after that millisecond was
+// counted (its interrupt is pending and has not counted it yet). The value
+// must be read after the pending flag was seen.
+static inline uint32_t timebase_cycles_from(uint32_t ms, uint32_t val,
+					    bool wrapPending,
+					    uint32_t cyclesPerMs) {
+  if (wrapPending) {
+    ms++;
+  }
+  return (ms * cyclesPerMs) + (cyclesPerMs - 1U - val);
+}
+
+#endif // _TIMEBASE_H_
@@ -0,0 +1,223 @@
+// DMA transmit engine for USART0. See uart_dma.h.
+
+#include "fsl_device_registers.h"
+#include "fsl_dma.h"
+#include "fsl_usart.h"
+#include "uart_dma.h"
+#include "deadline_mon.h"
+
+// DMA channel 1 is requested by USART0 TX.
+// See: Table "DMA requests" in the DMA chapter of the User Manual.
+#define UART_DMA_CHANNEL 1U
+
+#define FRG_DIV 256U   // UARTFRGDIV = 255 is required; this value +1 is used.
+
+typedef struct {
+  const uint8_t *data;
+  uint16_t len;
+  uart_dma_callback_t callback;
+  void *userData;
+} uart_dma_item_t;
+
+// Queue of buffers. The item at 'first' is being sent.
+static uart_dma_item_t queue[UART_DMA_QUEUE_LEN];
+static volatile uint8_t first;
+static volatile uint8_t count;
+static volatile bool sending;         // The DMA is sending queue[first].
+static volatile uint8_t consoleHold;  // > 0: console text is being written.
+static uint8_t deadlineId = DEADLINE_INVALID;
+
+static dma_handle_t dmaHandle;
+
+
+bool uart_dma_calc_baud(uint32_t srcClock_Hz, uint32_t baudrate,
+			uart_baud_config_t *config) {
+
+  uint32_t mult;
+  uint64_t num;
+  uint64_t den;
+  uint64_t div;
+  uint64_t actual;
+  int64_t error;
+  uint32_t absError;
+  uint32_t bestError = 0xFFFFFFFFU;
+
+  if ((baudrate == 0U) || (baudrate > (srcClock_Hz / 16U))) {
+    return false;
+  }
+
+  // U_PCLK = srcClock * 256 / (256 + MULT)
+  // baud   = U_PCLK / (16 * (BRG + 1))
+  // For each MULT the best BRG is found by rounding; the MULT with the
+  // smallest error is kept. The smallest MULT wins on equal error, since
+  // the fractional divider adds jitter to the clock.
+  num = (uint64_t)srcClock_Hz * FRG_DIV;
+  for (mult = 0; mult < 256U; mult++) {
+    den = (uint64_t)16U * baudrate * (FRG_DIV + mult);
+    div = (num + den / 2U) / den;
+    if ((div == 0U) || (div > 0x10000U)) {
+      continue;
+    }
+
+    den = (uint64_t)16U * (FRG_DIV + mult) * div;
+    actual = (num + den / 2U) / den;
+    error = (((int64_t)actual - (int64_t)baudrate) * 1000000) / baudrate;
+    absError = (uint32_t)((error < 0) ? -error : error);
+
+    if (absError < bestError) {
+      bestError = absError;
+      config->baudrate = (uint32_t)actual;
+      config->brg = (uint32_t)(div - 1U);
+      config->frgMult = (uint8_t)mult;
+      config->errorPpm = (int32_t)error;
+      if (absError == 0U) {
+	break;
+      }
+    }
+  }
+
+  return (bestError != 0xFFFFFFFFU);
+}
+
+
+status_t uart_dma_set_baud(uint32_t srcClock_Hz, uint32_t baudrate,
+			   uart_baud_config_t *config) {
+
+  if (!uart_dma_calc_baud(srcClock_Hz, baudrate, config)) {
+    return kStatus_InvalidArgument;
+  }
+
+  // No DMA frame may be cut, and the last character must leave the shift
+  // register:
+  uart_dma_console_begin();
+  while ((USART0->STAT & USART_STAT_TXIDLE_MASK) == 0U) {
+  }
+
+  // The FRG is shared by all USARTs. See: 4.6.21 and 4.6.22 in SYSCON.
+  SYSCON->UARTFRGDIV = FRG_DIV - 1U;
+  SYSCON->UARTFRGMULT = config->frgMult;
+  USART0->BRG = config->brg;
+  uart_dma_console_end();
+
+  return kStatus_Success;
+}
+
+
+// Start the DMA for the first item of the queue.
+static void start_first(void) {
+
+  dma_transfer_config_t transferConfig;
+  uart_dma_item_t *item = &queue[first];
+
+  sending = true;
+  DMA_PrepareTransfer(&transferConfig,
+		      (void *)item->data,
+		      (void *)&USART0->TXDAT,
+		      sizeof(uint8_t),       // One byte per request.
+		      item->len,
+		      kDMA_MemoryToPeripheral,
+		      NULL);                 // No linked descriptor.
+  DMA_SubmitTransfer(&dmaHandle, &transferConfig);
+  DMA_StartTransfer(&dmaHandle);
+}
+
+
+// Called by the DMA driver ISR when a buffer is sent.
+static void dma_done_callback(dma_handle_t *handle, void *param,
+			      bool transferDone, uint32_t tcds) {
+
+  uart_dma_item_t item = queue[first];
+
+  if (deadlineId != DEADLINE_INVALID) {
+    deadline_begin(deadlineId);
+  }
+  first = (uint8_t)((first + 1U) % UART_DMA_QUEUE_LEN);
+  count--;
+  sending = false;
+  if ((count > 0U) && (consoleHold == 0U)) {
+    start_first();   // Keep the USART busy before calling back.
+  }
+
+  if (item.callback != NULL) {
+    item.callback(item.data, item.len, item.userData);
+  }
+  if (deadlineId != DEADLINE_INVALID) {
+    deadline_end(deadlineId);
+  }
+}
+
+
+void uart_dma_init(void) {
+
+  first = 0;
+  count = 0;
+  sending = false;
+  consoleHold = 0;
+
+  DMA_Init(DMA0);
+  DMA_EnableChannel(DMA0, UART_DMA_CHANNEL);
+  DMA_EnableChannelPeriphRq(DMA0, UART_DMA_CHANNEL); // Paced by USART0 TXRDY.
+  DMA_CreateHandle(&dmaHandle, DMA0, UART_DMA_CHANNEL); // Also enables DMA0 IRQ.
+  DMA_SetCallback(&dmaHandle, dma_done_callback, NULL);
+}
+
+
+void uart_dma_set_deadline(uint8_t id) {
+  deadlineId = id;
+}
+
+
+// May be called from the main loop and from ISRs.
+status_t uart_dma_send(const uint8_t *data, uint16_t len,
+		       uart_dma_callback_t callback, void *userData) {
+
+  uint32_t primask;
+  uart_dma_item_t *item;
+
+  if ((len == 0U) || (len > UART_DMA_MAX_LEN)) {
+    return kStatus_InvalidArgument;
+  }
+
+  primask = DisableGlobalIRQ();
+  if (count == UART_DMA_QUEUE_LEN) {
+    EnableGlobalIRQ(primask);
+    return kStatus_Fail;
+  }
+
+  item = &queue[(first + count) % UART_DMA_QUEUE_LEN];
+  item->data = data;
+  item->len = len;
+  item->callback = callback;
+  item->userData = userData;
+  count++;
+
+  if (!sending && (consoleHold == 0U)) {   // The DMA was idle.
+    start_first();
+  }
+  EnableGlobalIRQ(primask);
+
+  return kStatus_Success;
+}
+
+
+void uart_dma_console_begin(void) {
+
+  uint32_t primask = DisableGlobalIRQ();
+  consoleHold++;
+  EnableGlobalIRQ(primask);
+
+  // The buffer being sent is finished by the DMA ISR (higher priority):
+  while (sending) {
+  }
+}
+
+
+void uart_dma_console_end(void) {
+
+  uint32_t primask = DisableGlobalIRQ();
+  consoleHold--;
+  if ((consoleHold == 0U) && !sending && (count > 0U)) {
+    start_first();
+  }
+  EnableGlobalIRQ(primask);
+}
@@ -0,0 +1,82 @@
+// DMA transmit engine for USART0 and baud rate calculation.
+//
+// Buffers given to uart_dma_send() are put into a queue and sent by DMA
+// channel 1 (USART0_TX request), one after the other. The CPU is free
+// while the bytes are going out. When a buffer is sent, its callback is
+// called (in the DMA interrupt) and the buffer may be used again.
+//
+// PRINTF writes the same USART0 TXDAT register, one character at a time.
+// Console text must therefore be written with CONSOLE_PRINTF(): it waits
+// until the buffer being sent is finished, and the queued buffers are
+// started after the text. (Otherwise a reply in the middle of a binary
+// frame would corrupt the frame.)
+//
+// The baud rate functions use both the USART divider (BRG) and the
+// fractional rate generator (FRG) of SYSCON, so that high rates
+// (up to clock/16, i.e. 1.875 Mbaud at 30 MHz) can be set with small error.
+// See: User Manual Sec. 13.7.1 Clocking and baud rates.
+
+#ifndef _UART_DMA_H_
+#define _UART_DMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fsl_common.h"
+#include "fsl_debug_console.h"
+
+#define UART_DMA_QUEUE_LEN 4U    // Number of buffers that can wait.
+#define UART_DMA_MAX_LEN   1024U // One DMA descriptor moves at most 1024 bytes.
+
+// Called when the buffer has been sent (from the DMA ISR).
+typedef void (*uart_dma_callback_t)(const uint8_t *data, uint16_t len,
+				    void *userData);
+
+// Result of the baud rate calculation.
+typedef struct {
+  uint32_t baudrate;  // Actual baud rate.
+  uint32_t brg;       // Value for the USART BRG register (divider - 1).
+  uint8_t frgMult;    // Value for SYSCON UARTFRGMULT (UARTFRGDIV is 255).
+  int32_t errorPpm;   // (actual - requested) / requested, in ppm.
+} uart_baud_config_t;
+
+// Find BRG and FRG values for the requested baud rate.
+// srcClock_Hz is the clock after UARTCLKDIV.
+// Returns false if the rate can not be generated.
+bool uart_dma_calc_baud(uint32_t srcClock_Hz, uint32_t baudrate,
+			uart_baud_config_t *config);
+
+// Calculate and apply the baud rate to USART0.
+// Waits until the transmitter is idle before changing the registers.
+status_t uart_dma_set_baud(uint32_t srcClock_Hz, uint32_t baudrate,
+			   uart_baud_config_t *config);
+
+// USART0 must already be initialized (uart_init()).
+void uart_dma_init(void);
+
+// Put a buffer into the transmit queue. The buffer must not change until
+// its callback is called. callback may be NULL.
+// Returns kStatus_Fail if the queue is full or len is too large.
+status_t uart_dma_send(const uint8_t *data, uint16_t len,
+		       uart_dma_callback_t callback, void *userData);
+
+// Take USART0 for console text: wait until the DMA is not sending, and do
+// not start the next buffer until uart_dma_console_end(). May be nested
+// (e.g. PendSV printing while the main loop prints). Must not be called
+// from an ISR of the DMA priority level or higher.
+void uart_dma_console_begin(void);
+void uart_dma_console_end(void);
+
+// Deadline monitor id (deadline_mon.h) of the DMA ISR work when a buffer
+// is sent. Buffers are sent at irregular times, so only its budget is
+// checked.
+void uart_dma_set_deadline(uint8_t id);
+
+// PRINTF that does not mix its characters into the DMA frames.
+#define CONSOLE_PRINTF(...)			\
+  do {						\
+    uart_dma_console_begin();			\
+    PRINTF(__VA_ARGS__);			\
+    uart_dma_console_end();			\
+  } while (0)
+
+#endif // _UART_DMA_H_
@@ -0,0 +1,179 @@
+// Time stamped capture of pin interrupt (PINT) events. See pin_event.h.
+//
+// The PIN_INTn_IRQHandler functions below replace the ones of the PINT
+// driver (fsl_pint.c), so the driver's callbacks are not called.
+
+#include "fsl_device_registers.h"
+#include "fsl_clock.h"
+#include "fsl_sctimer.h"
+#include "pin_event.h"
+
+#define PIN_EVENT_MASK (PIN_EVENT_RING_SIZE - 1U)
+#define NO_PIN 0xFFU
+
+// Ring buffer. head is only written by the ISRs, tail only by
+// pin_event_get(). Both are free running: (head - tail) entries are used.
+static pin_event_t ring[PIN_EVENT_RING_SIZE];
+static volatile uint8_t head;
+static volatile uint8_t tail;
+
+static uint32_t coalesceTicks;
+static uint8_t enabledEdges[8];   // Edges enabled for each PINT.
+
+static volatile pin_event_stats_t stats;
+
+// Hardware capture for latency measurement:
+static uint8_t latencyPin = NO_PIN;
+static uint32_t captureRise;   // SCT capture register numbers.
+static uint32_t captureFall;
+
+
+// Called first in every PINT ISR.
+static inline void pin_event_capture(uint32_t pin) {
+
+  uint32_t now = SCT0->COUNT;   // Time stamp before anything else.
+  uint32_t mask = 1U << pin;
+  uint8_t edges = 0;
+  uint8_t used;
+  uint32_t latency;
+  pin_event_t *event;
+
+  // Which edge was it? See: 11.6.8 and 11.6.9 in the User Manual.
+  if (PINT->RISE & mask) {
+    edges |= PIN_EVENT_RISE;
+  }
+  if (PINT->FALL & mask) {
+    edges |= PIN_EVENT_FALL;
+  }
+  PINT->IST = mask;   // Clear both edge detections of this pin.
+  edges &= enabledEdges[pin];
+  if (edges == 0U) {
+    return;
+  }
+  stats.captured++;
+
+  if (pin == latencyPin) {
+    latency = now - SCT0->CAP[(edges & PIN_EVENT_FALL) ? captureFall : captureRise];
+    stats.latencyLast = latency;
+    if (latency > stats.latencyMax) {
+      stats.latencyMax = latency;
+    }
+  }
+
+  used = (uint8_t)(head - tail);
+
+  // Add to the last entry if it is part of a burst. Only if the main loop
+  // can not be reading that entry, i.e. it is not the oldest one.
+  if (used >= 2U) {
+    event = &ring[(uint8_t)(head - 1U) & PIN_EVENT_MASK];
+    if ((event->pin == pin) && ((now - event->last) <= coalesceTicks) &&
+	(event->count < 0xFFFFU)) {
+      event->last = now;
+      event->count++;
+      event->edges |= edges;
+      stats.coalesced++;
+      return;
+    }
+  }
+
+  if (used == PIN_EVENT_RING_SIZE) {
+    stats.dropped++;
+    return;
+  }
+
+  event = &ring[head & PIN_EVENT_MASK];
+  event->first = now;
+  event->last = now;
+  event->count = 1;
+  event->pin = (uint8_t)pin;
+  event->edges = edges;
+  head++;   // The entry is visible to the main loop only now.
+}
+
+
+void pin_event_init(uint32_t ticks) {
+
+  sctimer_config_t sctimerConfig;
+
+  coalesceTicks = ticks;
+  head = 0;
+  tail = 0;
+
+  // SCT0 as one 32 bit counter at the core clock, without limit:
+  // it counts up to 0xFFFFFFFF and starts again from 0.
+  CLOCK_EnableClock(kCLOCK_Sct);
+  SCTIMER_GetDefaultConfig(&sctimerConfig);  // Unified, no prescaler.
+  SCTIMER_Init(SCT0, &sctimerConfig);
+  SCTIMER_StartTimer(SCT0, kSCTIMER_Counter_U);
+}
+
+
+void pin_event_enable(pint_pin_int_t pin, pint_pin_enable_t enable) {
+
+  enabledEdges[pin] = 0;
+  if ((enable == kPINT_PinIntEnableRiseEdge) || (enable == kPINT_PinIntEnableBothEdges)) {
+    enabledEdges[pin] |= PIN_EVENT_RISE;
+  }
+  if ((enable == kPINT_PinIntEnableFallEdge) || (enable == kPINT_PinIntEnableBothEdges)) {
+    enabledEdges[pin] |= PIN_EVENT_FALL;
+  }
+
+  // No callback: the ISRs of this file handle the interrupt.
+  PINT_PinInterruptConfig(PINT, pin, enable, NULL);
+  PINT_EnableCallbackByIndex(PINT, pin); // Clears old flags, enables IRQ.
+}
+
+
+void pin_event_measure_latency(pint_pin_int_t pin, swm_port_pin_type_t portPin) {
+
+  uint32_t riseEvent;
+  uint32_t fallEvent;
+
+  // SCT input 0 reads the same pin as the PINT:
+  CLOCK_EnableClock(kCLOCK_Swm);
+  SWM_SetMovablePinSelect(SWM0, kSWM_SCT_PIN0, portPin);
+  CLOCK_DisableClock(kCLOCK_Swm);
+
+  SCTIMER_StopTimer(SCT0, kSCTIMER_Counter_U);   // Halt while configuring.
+
+  // Capture the counter at each edge of input 0:
+  SCTIMER_CreateAndScheduleEvent(SCT0, kSCTIMER_InputRiseEvent, 0,
+				 kSCTIMER_Input_0, kSCTIMER_Counter_U, &riseEvent);
+  SCTIMER_SetupCaptureAction(SCT0, kSCTIMER_Counter_U, &captureRise, riseEvent);
+  SCTIMER_CreateAndScheduleEvent(SCT0, kSCTIMER_InputFallEvent, 0,
+				 kSCTIMER_Input_0, kSCTIMER_Counter_U, &fallEvent);
+  SCTIMER_SetupCaptureAction(SCT0, kSCTIMER_Counter_U, &captureFall, fallEvent);
+
+  SCTIMER_StartTimer(SCT0, kSCTIMER_Counter_U);
+  latencyPin = (uint8_t)pin;
+}
+
+
+bool pin_event_get(pin_event_t *event) {
+
+  if (head == tail) {
+    return false;
+  }
+  *event = ring[tail & PIN_EVENT_MASK];
+  tail++;   // The ISR may use the entry again only now.
+  return true;
+}
+
+
+void pin_event_get_stats(pin_event_stats_t *copy) {
+
+  uint32_t primask = DisableGlobalIRQ();
+  *copy = stats;
+  EnableGlobalIRQ(primask);
+}
+
+
+// PINT interrupts. They were declared in the file startup_LPC824.S.
+void PIN_INT0_IRQHandler(void) { pin_event_capture(0); }
+void PIN_INT1_IRQHandler(void) { pin_event_capture(1); }
+void PIN_INT2_IRQHandler(void) { pin_event_capture(2); }
+void PIN_INT3_IRQHandler(void) { pin_event_capture(3); }
+void PIN_INT4_IRQHandler(void) { pin_event_capture(4); }
+void PIN_INT5_IRQHandler(void) { pin_event_capture(5); }
+void PIN_INT6_IRQHandler(void) { pin_event_capture(6); }
+void PIN_INT7_IRQHandler(void) { pin_event_capture(7); }
@@ -0,0 +1,61 @@
+// Time stamped capture of pin interrupt (PINT) events.
+//
+// Each PINT edge is stamped with the value of a free running 32 bit timer
+// (SCT0 unified counter at the core clock) as the first thing in the ISR.
+// Pin, edge and time stamp are written into a ring buffer. The ISR writes
+// and the main loop reads, so no locking is needed.
+//
+// Bursts: an edge on the same pin within 'coalesceTicks' of the previous
+// one is added to the previous entry (count and last time stamp) instead of
+// using a new entry, if the main loop has not started reading that entry.
+//
+// ISR latency: if the same pin is also connected to SCT input 0
+// (pin_event_measure_latency()), the SCT captures the counter at the edge
+// in hardware. The difference to the ISR time stamp is the latency.
+
+#ifndef _PIN_EVENT_H_
+#define _PIN_EVENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fsl_pint.h"
+#include "fsl_swm.h"
+
+#define PIN_EVENT_RING_SIZE 32U  // Must be a power of 2.
+
+#define PIN_EVENT_RISE 0x01U
+#define PIN_EVENT_FALL 0x02U
+
+typedef struct {
+  uint32_t first;   // Time stamp of the first edge (timer ticks).
+  uint32_t last;    // Time stamp of the last edge of a burst.
+  uint16_t count;   // Number of edges in this entry (1 if no burst).
+  uint8_t pin;      // PINT number (kPINT_PinInt0 .. 7).
+  uint8_t edges;    // PIN_EVENT_RISE and/or PIN_EVENT_FALL.
+} pin_event_t;
+
+typedef struct {
+  uint32_t captured;    // Edges seen by the ISR.
+  uint32_t coalesced;   // Edges added to an existing entry.
+  uint32_t dropped;     // Edges lost because the ring was full.
+  uint32_t latencyLast; // Edge to ISR entry, timer ticks.
+  uint32_t latencyMax;
+} pin_event_stats_t;
+
+// Starts the SCT0 counter as the time base. SCT0 must not be used for
+// anything else.
+void pin_event_init(uint32_t coalesceTicks);
+
+// Enable the PINT interrupt of 'pin' for the given edges.
+// The pin must already be connected to the PINT with SYSCON_AttachSignal().
+void pin_event_enable(pint_pin_int_t pin, pint_pin_enable_t enable);
+
+// Connect portPin also to SCT input 0, to measure the ISR latency of 'pin'.
+void pin_event_measure_latency(pint_pin_int_t pin, swm_port_pin_type_t portPin);
+
+// Take the oldest entry from the ring. Returns false if it is empty.
+bool pin_event_get(pin_event_t *event);
+
+void pin_event_get_stats(pin_event_stats_t *stats);
+
+#endif // _PIN_EVENT_H_
@@ -10,6 +10,7 @@
 #include "fsl_power.h"
 #include "fsl_clock.h"
 #include "fsl_syscon.h"
+#include "pin_event.h"
 
 
 #define USART_INSTANCE   0U
@@ -17,21 +18,42 @@
 
 #define CORE_CLOCK   30000000U  // Set CPU Core clock frequency (Hz)
 
+#define TICKS_PER_US (CORE_CLOCK / 1000000U) // Time stamps are in core clocks.
+#define BURST_US 1000U  // Edges closer than this are reported as one burst.
+
 void clock_init(void);
 status_t uart_init(void);
+void print_pin_events(void);
 
 uint8_t led_state;
 
 
-///////////  This is the ISR callback for PIN INTERRUPT: ////////////
-// The actual ISR is in file fsl_pint.c and has no arguments. 
-
-// The arguments are defined in fsl_pint.c file around line 794
-// within the declaration:
-//  void PIN_INT0_DriverIRQHandler(void)
-// Check that file for more details.
-void pint_intr_callback(pint_pin_int_t pintr, uint32_t pmatch_status) {
-  PRINTF("\f\r\nPINT Pin Interrupt %d event detected.", pintr);
+///////////  PIN INTERRUPT events: ////////////
+// The ISRs are in file pin_event.c. They only store the pin, the edge and
+// the time of each event; printing is done in the main loop.
+// Printing in the ISR would lose the events that come during PRINTF.
+void print_pin_events(void) {
+
+  static uint32_t previous;  // Time stamp of the previous event.
+  pin_event_t event;
+  pin_event_stats_t stats;
+
+  while (pin_event_get(&event)) {
+    PRINTF("\r\nPINT %d %s, +%d us",
+	   event.pin,
+	   (event.edges == PIN_EVENT_FALL) ? "fall" :
+	   (event.edges == PIN_EVENT_RISE) ? "rise" : "both",
+	   (event.first - previous) / TICKS_PER_US);
+    if (event.count > 1U) {
+      PRINTF(", burst of %d edges in %d us",
+	     event.count, (event.last - event.first) / TICKS_PER_US);
+    }
+    previous = event.last;
+
+    pin_event_get_stats(&stats);
+    PRINTF(" (dropped %d, latency %d/%d cycles)",
+	   stats.dropped, stats.latencyLast, stats.latencyMax);
+  }
 }
 
 
@@ -49,27 +71,29 @@ int main(void) {
   SYSCON_AttachSignal(SYSCON, kPINT_PinInt1, kSYSCON_GpioPort0Pin12ToPintsel);
   
   PINT_Init(PINT);  // Initialize PIN Interrupts
+
+  // Start the time base (SCT0) for the event time stamps:
+  pin_event_init(BURST_US * TICKS_PER_US);
   
   // Setup Pin Interrupt 1:
   //  falling edge triggers the INT
-  //  register the name of the callback function (as the last argument).
-  PINT_PinInterruptConfig(PINT,                // Pin INT base register address
-			  kPINT_PinInt1,       // Use Pin INT 1
-			  kPINT_PinIntEnableFallEdge, // At falling edge.
-			  pint_intr_callback); // Name of the callback function
-  
-  // Enable callbacks for PINT0 by Index:
-  // This clears the pending INT flags
+  //  This clears the pending INT flags
   //  and enables the interrupts for this PIN INT.
-  PINT_EnableCallbackByIndex(PINT, kPINT_PinInt1);
+  pin_event_enable(kPINT_PinInt1,                // Use Pin INT 1
+		   kPINT_PinIntEnableFallEdge);  // At falling edge.
+
+  // PIO_12 is also connected to SCT input 0. The SCT captures the time of
+  // the edge in hardware, so the ISR latency can be measured:
+  pin_event_measure_latency(kPINT_PinInt1, kSWM_PortPin_P0_12);
   
   PRINTF("PINT Pin Interrupt events are configured\r\n");
   PRINTF("Press SW2 to generate events\r\n");
   
   
   while (1) {
-    __WFI();  // Wait for interrupt and do nothing.
+    __WFI();  // Wait for interrupt.
     // Processor sleeps here.
+    print_pin_events();
   }
 }
 